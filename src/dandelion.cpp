@@ -1,17 +1,44 @@
+#include <algorithm>
+#include <array>
 #include <atomic>
+#include <bitset>
 #include <chrono>
 #include <cmath>
+#include <complex>
 #include <condition_variable>
 #include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
 #include <forward_list>
 #include <fstream>
 #include <iostream>
 #include <mutex>
-#include <queue>
+#include <new>
 #include <random>
 #include <thread>
+#include <tuple>
 #include <vector>
 
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#endif
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#if defined(__linux__)
+#include <climits>
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
 #include <raylib.h>
 #include <raymath.h>
 
@@ -39,34 +66,108 @@ constexpr int bottom_bar_height = 40;
 constexpr int win_width = view_width;
 constexpr int win_height = top_bar_height + view_height + bottom_bar_height;
 
-constexpr int segments = 100;
+// the field is segments by segments cells, set with --size
+int segments = 100;
 constexpr int day_length = 1000.0f;
 
 Vector2 camera = {0.0f, 0.0f};
 double zoom = 1.0;
 constexpr double zoom_mult = 1.02;
 
-io::CSVReader<5> *reader;
-
-std::mt19937 mtrandom;
-std::mt19937 mtrandom1;
-std::mt19937 mtrandom2;
-std::mt19937 mtrandom3;
-std::mt19937 mtrandom4;
-std::normal_distribution germination_dist(17.0f, 1.0f);
-std::normal_distribution mature_dist(30.0f, 2.7f);
-std::normal_distribution flower_dist(50.0f, 2.7f);
-std::normal_distribution wither_dist(10.0f, 1.4f);
-std::normal_distribution puffball_dist(15.0f, 1.4f);
-std::uniform_int_distribution<int> sub_mature_dist(300, 400);
-std::normal_distribution wind_dist_dist(0.0f, 6.0f);
-std::normal_distribution wind_angle_dist_normal(0.0f, 20.0f);
-std::uniform_int_distribution<int> wind_angle_dist_uniform(0, 359);
-std::uniform_int_distribution<int> seeds_dist(1500, 2000);
+// Philox4x32-10 counter based generator (Salmon et al. 2011). A stream is
+// picked by the key, which is the run's seed, and the first three counter
+// words, so what gets drawn only depends on the seed, the day and what is
+// being drawn for, never on which thread draws it or when.
+struct Philox {
+  using result_type = std::uint32_t;
+
+  std::uint32_t key[2];
+  std::uint32_t counter[4];
+  std::uint32_t block[4] = {};
+  int used = 4;
+
+  Philox(std::uint64_t seed, std::uint32_t day, std::uint32_t cell,
+         std::uint32_t stream)
+      : key{static_cast<std::uint32_t>(seed),
+            static_cast<std::uint32_t>(seed >> 32)},
+        counter{day, cell, stream, 0} {}
+
+  static constexpr result_type min() { return 0; }
+  static constexpr result_type max() { return UINT32_MAX; }
+
+  result_type operator()() {
+    if (used == 4) {
+      next_block();
+    }
+    return block[used++];
+  }
+
+  void next_block() {
+    std::uint32_t c[4] = {counter[0], counter[1], counter[2], counter[3]};
+    std::uint32_t k[2] = {key[0], key[1]};
+    for (int round = 0; round < 10; ++round) {
+      std::uint64_t p0 = 0xD2511F53ull * c[0];
+      std::uint64_t p1 = 0xCD9E8D57ull * c[2];
+      std::uint32_t c1 = c[1];
+      std::uint32_t c3 = c[3];
+      c[0] = static_cast<std::uint32_t>(p1 >> 32) ^ c1 ^ k[0];
+      c[1] = static_cast<std::uint32_t>(p1);
+      c[2] = static_cast<std::uint32_t>(p0 >> 32) ^ c3 ^ k[1];
+      c[3] = static_cast<std::uint32_t>(p0);
+      k[0] += 0x9E3779B9;
+      k[1] += 0xBB67AE85;
+    }
+    std::copy(c, c + 4, block);
+    counter[3]++;
+    used = 0;
+  }
+};
+
+// --seed, random unless given
+std::uint64_t run_seed = 0;
+
+// Only the parameters of these are shared between threads. Normals are drawn
+// with fill_normals and the uniforms through draw.
+const std::normal_distribution germination_dist(17.0f, 1.0f);
+const std::normal_distribution mature_dist(30.0f, 2.7f);
+const std::normal_distribution flower_dist(50.0f, 2.7f);
+const std::normal_distribution wither_dist(10.0f, 1.4f);
+const std::normal_distribution puffball_dist(15.0f, 1.4f);
+const std::uniform_int_distribution<int> sub_mature_dist(300, 400);
+const std::normal_distribution wind_dist_dist(0.0f, 6.0f);
+const std::normal_distribution wind_angle_dist_normal(0.0f, 20.0f);
+const std::uniform_int_distribution<int> wind_angle_dist_uniform(0, 359);
+const std::uniform_int_distribution<int> seeds_dist(1500, 2000);
 constexpr int seedling_eaten_chance = 55;
-std::uniform_int_distribution<int> hundred_dist(1, 100);
+const std::uniform_int_distribution<int> hundred_dist(1, 100);
 std::atomic<int> ratio = 1;
 
+// Draws from a copy of one of the shared distributions above
+template <typename D> typename D::result_type draw(const D &dist, Philox &rng) {
+  D fresh(dist.param());
+  return fresh(rng);
+}
+
+// Fills out with n standard normals, two from every pair of draws
+// (Box-Muller), so a Philox block gives four
+void fill_normals(Philox &rng, float *out, int n) {
+  for (int i = 0; i < n; i += 2) {
+    // u1 is in (0, 1] to keep the log finite
+    float u1 = ((rng() >> 8) + 1) * 0x1.0p-24f;
+    float u2 = (rng() >> 8) * 0x1.0p-24f;
+    float r = std::sqrt(-2.0f * std::log(u1));
+    float theta = 2.0f * PI * u2;
+    out[i] = r * std::cos(theta);
+    if (i + 1 < n) {
+      out[i + 1] = r * std::sin(theta);
+    }
+  }
+}
+
+float scale_normal(const std::normal_distribution<float> &dist, float z) {
+  return dist.mean() + dist.stddev() * z;
+}
+
 struct Dandelion {
   enum class Stage : uint8_t {
     Germinating,
@@ -92,575 +193,2631 @@ struct Dandelion {
 
   Dandelion() = delete;
 
-  Dandelion(std::mt19937 &mt)
-      : age(0), days_since_last_stage(0), stage(Stage::Germinating), health(50),
-        germination_time(germination_dist(mt)), mature_time(mature_dist(mt)),
-        flower_time(flower_dist(mt)), wither_time(wither_dist(mt)),
-        puffball_time(puffball_dist(mt)), sub_mature_time(sub_mature_dist(mt)),
-        is_first(false) {}
+  Dandelion(Philox &rng) {
+    float z[5];
+    fill_normals(rng, z, 5);
+    germination_time = scale_normal(germination_dist, z[0]);
+    mature_time = scale_normal(mature_dist, z[1]);
+    flower_time = scale_normal(flower_dist, z[2]);
+    wither_time = scale_normal(wither_dist, z[3]);
+    puffball_time = scale_normal(puffball_dist, z[4]);
+    sub_mature_time = draw(sub_mature_dist, rng);
+  }
+};
+
+inline std::uint8_t effective_time(std::uint16_t time, std::uint8_t health) {
+  if (health >= 50) {
+    return time;
+  }
+  return (1.0f - static_cast<float>(50 - health) / 100.0f) * time;
+}
+
+struct GridCoords {
+  int x, y;
+};
+struct NewSeed {
+  GridCoords coords;
+  Dandelion dandelion;
+  // field cell the seed came from in the high half, and its number among that
+  // cell's seeds of the day in the low half. Births are inserted in this
+  // order.
+  std::uint64_t source = 0;
+};
+
+// Bytes the population's storage holds, and the most it has held: the
+// dandelion and cohort stores, the seeds and seed counts in flight, the
+// convolution buffers and the frames' densities. They are grown geometrically
+// and keep their capacity from day to day, so their total is what a run's
+// memory use follows.
+std::atomic<std::size_t> population_bytes = 0;
+std::atomic<std::size_t> population_peak = 0;
+
+template <typename T> struct PopulationAllocator {
+  using value_type = T;
+
+  PopulationAllocator() = default;
+  template <typename U> PopulationAllocator(const PopulationAllocator<U> &) {}
+
+  T *allocate(std::size_t n) {
+    std::size_t bytes =
+        population_bytes.fetch_add(n * sizeof(T), std::memory_order_relaxed) +
+        n * sizeof(T);
+    std::size_t peak = population_peak.load(std::memory_order_relaxed);
+    while (peak < bytes && !population_peak.compare_exchange_weak(
+                               peak, bytes, std::memory_order_relaxed)) {
+    }
+    return static_cast<T *>(::operator new(n * sizeof(T)));
+  }
+  void deallocate(T *p, std::size_t n) {
+    population_bytes.fetch_sub(n * sizeof(T), std::memory_order_relaxed);
+    ::operator delete(p);
+  }
+
+  bool operator==(const PopulationAllocator &) const { return true; }
+  bool operator!=(const PopulationAllocator &) const { return false; }
+};
+
+template <typename T>
+using PopulationVector = std::vector<T, PopulationAllocator<T>>;
+
+// Columnar storage for the dandelions of one quadrant. The dandelions of cell
+// c (row-major) are at [cell_start[c], cell_start[c + 1]).
+struct DandelionStore {
+  PopulationVector<std::uint16_t> age;
+  PopulationVector<std::uint16_t> days_since_last_stage;
+  PopulationVector<Dandelion::Stage> stage;
+  PopulationVector<std::uint8_t> health;
+  PopulationVector<std::uint8_t> germination_time;
+  PopulationVector<std::uint8_t> mature_time;
+  PopulationVector<std::uint8_t> flower_time;
+  PopulationVector<std::uint8_t> wither_time;
+  PopulationVector<std::uint8_t> puffball_time;
+  PopulationVector<std::uint16_t> sub_mature_time;
+  PopulationVector<std::uint8_t> is_first;
+  PopulationVector<std::uint32_t> cell_start;
+  PopulationVector<std::uint32_t> cell_fill;
+
+  DandelionStore(int cells) : cell_start(cells + 1, 0), cell_fill(cells, 0) {}
+
+  template <typename F> void for_each_column(F f) {
+    f(age);
+    f(days_since_last_stage);
+    f(stage);
+    f(health);
+    f(germination_time);
+    f(mature_time);
+    f(flower_time);
+    f(wither_time);
+    f(puffball_time);
+    f(sub_mature_time);
+    f(is_first);
+  }
+
+  std::size_t size() const { return age.size(); }
+
+  // shrinking keeps the capacity around for the next births
+  void resize(std::size_t n) {
+    for_each_column([n](auto &column) { column.resize(n); });
+  }
+
+  void move(std::size_t from, std::size_t to) {
+    for_each_column([from, to](auto &column) { column[to] = column[from]; });
+  }
+
+  void set(std::size_t i, const Dandelion &dand) {
+    age[i] = dand.age;
+    days_since_last_stage[i] = dand.days_since_last_stage;
+    stage[i] = dand.stage;
+    health[i] = dand.health;
+    germination_time[i] = dand.germination_time;
+    mature_time[i] = dand.mature_time;
+    flower_time[i] = dand.flower_time;
+    wither_time[i] = dand.wither_time;
+    puffball_time[i] = dand.puffball_time;
+    sub_mature_time[i] = dand.sub_mature_time;
+    is_first[i] = dand.is_first;
+  }
+
+  // Shifts the cells back to front in place so that cell c gains cell_fill[c]
+  // free slots at its end, and points cell_fill[c] at the first of them
+  void make_room() {
+    std::uint32_t added = 0;
+    for (auto count : cell_fill) {
+      added += count;
+    }
+    std::uint32_t old_end = size();
+    std::uint32_t new_end = size() + added;
+    resize(new_end);
+    for (std::size_t c = cell_fill.size(); c-- > 0;) {
+      std::uint32_t old_begin = cell_start[c];
+      std::uint32_t count = old_end - old_begin;
+      std::uint32_t new_begin = new_end - cell_fill[c] - count;
+      if (new_begin != old_begin && count > 0) {
+        for_each_column([old_begin, count, new_begin](auto &column) {
+          std::move_backward(column.begin() + old_begin,
+                             column.begin() + old_begin + count,
+                             column.begin() + new_begin + count);
+        });
+      }
+      cell_start[c + 1] = new_end;
+      cell_fill[c] = new_begin + count;
+      old_end = old_begin;
+      new_end = new_begin;
+    }
+  }
+
+  // Appends seeds (in local cell coordinates of a width wide quadrant) to the
+  // end of their cells, in order
+  void insert(const PopulationVector<NewSeed> &seeds, int width) {
+    if (seeds.empty()) {
+      return;
+    }
+    std::fill(cell_fill.begin(), cell_fill.end(), 0);
+    for (const auto &seed : seeds) {
+      cell_fill[seed.coords.y * width + seed.coords.x]++;
+    }
+    make_room();
+    for (const auto &seed : seeds) {
+      set(cell_fill[seed.coords.y * width + seed.coords.x]++, seed.dandelion);
+    }
+  }
+
+  // Appends counts[y * stride + x] new dandelions to each cell of a width wide
+  // tile, drawing those of cell c from cell_rng(c)
+  template <typename F>
+  void insert_new(const std::uint64_t *counts, int stride, int width,
+                  F cell_rng) {
+    bool any = false;
+    for (std::size_t c = 0; c < cell_fill.size(); ++c) {
+      cell_fill[c] = counts[(c / width) * stride + c % width];
+      any = any || cell_fill[c] > 0;
+    }
+    if (!any) {
+      return;
+    }
+    make_room();
+    for (std::size_t c = 0; c < cell_fill.size(); ++c) {
+      std::uint32_t end =
+          cell_fill[c] + counts[(c / width) * stride + c % width];
+      if (end == cell_fill[c]) {
+        continue;
+      }
+      Philox rng = cell_rng(c);
+      for (std::uint32_t i = cell_fill[c]; i < end; ++i) {
+        set(i, Dandelion(rng));
+      }
+    }
+  }
+};
+
+// Cohort mode keeps one record per group of dandelions in a cell that share
+// their stage, days in it and health. Each stage's duration is quantized into
+// duration_classes classes, and a cohort only tracks how many of its members
+// fall into each class of its current stage. The duration of the next stage
+// is drawn when members move on to it.
+constexpr int duration_classes = 16;
+
+struct DurationClasses {
+  // class k stands for first + k * step + step / 2 days
+  int first;
+  int step;
+  // chance of a new dandelion's duration falling into each class
+  double probability[duration_classes];
+
+  int duration(int k) const { return first + k * step + step / 2; }
+  int classify(int duration) const {
+    return clamp((duration - first) / step, 0, duration_classes - 1);
+  }
+};
+
+// indexed by Dandelion::Stage
+DurationClasses stage_classes[6] = {{9, 1, {}},  {22, 1, {}}, {42, 1, {}},
+                                    {2, 1, {}},  {7, 1, {}},  {300, 7, {}}};
+
+// The durations of a stage handle_dandelion's zero stage time check looks at,
+// with the chance of each and the ones that fail the check at each health
+struct CheckedDurations {
+  std::vector<double> chance;
+  std::vector<std::uint16_t> zero[256];
+};
+CheckedDurations checked_durations[5];
+
+// Splits n new members of a stage between its duration classes
+void sample_classes(const DurationClasses &classes, std::uint64_t n,
+                    std::array<std::uint64_t, duration_classes> &members,
+                    Philox &rng) {
+  members.fill(0);
+  double left = 1.0;
+  for (int k = 0; k < duration_classes - 1 && n > 0; ++k) {
+    double p = classes.probability[k];
+    if (p <= 0.0) {
+      continue;
+    }
+    std::uint64_t drawn = n;
+    if (p < left) {
+      drawn = std::binomial_distribution<std::uint64_t>(n, p / left)(rng);
+    }
+    members[k] = drawn;
+    n -= drawn;
+    left -= p;
+  }
+  members[duration_classes - 1] += n;
+}
+
+struct Cohort {
+  std::uint64_t count = 0;
+  std::uint16_t age = 0;
+  std::uint16_t days_since_last_stage = 0;
+  Dandelion::Stage stage = Dandelion::Stage::Germinating;
+  std::uint8_t health = 50;
+  bool is_first = false;
+  // health values the zero stage time check already ran at
+  std::bitset<256> checked_health;
+  std::array<std::uint64_t, duration_classes> members = {};
+};
+
+// Same layout as DandelionStore, but cohorts can split during a day so the
+// update writes into next and swaps
+struct CohortStore {
+  PopulationVector<Cohort> cohorts;
+  PopulationVector<std::uint32_t> cell_start;
+  PopulationVector<Cohort> next;
+  PopulationVector<std::uint32_t> next_start;
+
+  CohortStore(int cells) : cell_start(cells + 1, 0), next_start(cells + 1, 0) {}
+
+  void swap() {
+    cohorts.swap(next);
+    cell_start.swap(next_start);
+    next.clear();
+  }
+
+  // Adds a germinating cohort of counts[y * stride + x] dandelions to each
+  // cell of a width wide tile, drawn from cell_rng(c) for cell c
+  template <typename F>
+  void insert_new(const std::uint64_t *counts, int stride, int width,
+                  F cell_rng) {
+    std::size_t cells = cell_start.size() - 1;
+    next.clear();
+    for (std::size_t c = 0; c < cells; ++c) {
+      next_start[c] = next.size();
+      next.insert(next.end(), cohorts.begin() + cell_start[c],
+                  cohorts.begin() + cell_start[c + 1]);
+      std::uint64_t count = counts[(c / width) * stride + c % width];
+      if (count > 0) {
+        Cohort cohort;
+        cohort.count = count;
+        Philox rng = cell_rng(c);
+        sample_classes(stage_classes[0], count, cohort.members, rng);
+        next.push_back(cohort);
+      }
+    }
+    next_start[cells] = next.size();
+    swap();
+  }
+};
+
+// Seeds: every seed is a NewSeed in the worker's outboxes
+// Counts: workers only count seeds per cell, the master creates them in bulk
+enum class Dispersal { Seeds, Counts };
+Dispersal dispersal = Dispersal::Seeds;
+bool cohort_mode = false;
+// Pipelined days deliver each day's seeds while the next day advances the
+// tiles, instead of in a phase of their own
+bool pipelined = false;
+
+// Updated by the master from the workers' population_change and
+// population_born after each phase
+std::atomic<std::uint64_t> total_dandelion_number = 0;
+
+// The field is cut into tiles_x by tiles_x square tiles of tile_size cells
+// (the last row and column can be narrower). Tiles are the field's storage
+// chunks: nothing per cell is allocated until a tile is occupied, and only
+// occupied tiles are advanced, each by one of the workers.
+struct Tile {
+  // field cells [x, x + width) by [y, y + height)
+  int x, y, width, height;
+  bool occupied = false;
+  // dandelions per cell, row major. Only the worker handling the tile or the
+  // master between phases touch it.
+  PopulationVector<std::int64_t> density;
+  DandelionStore dandelions;
+  CohortStore cohorts;
+  PopulationVector<NewSeed> births;
+  // seeds each cell released today, on days they are convolved
+  PopulationVector<std::uint64_t> released;
+  // seeds were sent to it on the day being delivered
+  bool receiving = false;
+
+  Tile(int x, int y, int width, int height)
+      : x(x), y(y), width(width), height(height), dandelions(0), cohorts(0) {}
+};
+
+struct Worker {
+  // Outboxes, indexed by destination tile and only written by this worker.
+  // Seeds mode sends seeds in the tile's cell coordinates, counts mode counts
+  // them per cell of the tile (allocated on the tile's first seed).
+  std::vector<PopulationVector<NewSeed>> outboxes;
+  std::vector<PopulationVector<std::uint64_t>> seed_counts;
+  // the previous day's outboxes and seed_counts on pipelined days, which are
+  // delivered while the ones above fill up
+  std::vector<PopulationVector<NewSeed>> sent_outboxes;
+  std::vector<PopulationVector<std::uint64_t>> sent_counts;
+  // tiles sent seeds today
+  std::vector<std::size_t> sent_tiles;
+  std::vector<bool> sent;
+  std::vector<std::uint8_t> rcs;
+  std::vector<std::uint8_t> eaten_chances;
+  PopulationVector<std::uint64_t> delivered_counts;
+  // cells that released seeds today
+  std::size_t releasing_cells = 0;
+  // dandelions delivered, and those born less those died otherwise, in the
+  // current phase. A pipelined day tells the previous day's births apart.
+  std::int64_t population_born = 0;
+  std::int64_t population_change = 0;
+  // tiles dealt to this worker for the phase, heaviest first, from
+  // tile_front on. Idle workers steal from the back.
+  std::mutex tiles_mutex;
+  std::vector<std::size_t> tile_queue;
+  std::size_t tile_front = 0;
+};
+
+int tile_size = 100;
+int tiles_x = 1;
+// a deque so tiles never move
+std::deque<Tile> tiles;
+// occupied tiles, in the order they were occupied
+std::vector<std::size_t> active_tiles;
+std::vector<Worker> workers;
+
+std::size_t tile_index(int x, int y) {
+  return (y / tile_size) * tiles_x + x / tile_size;
+}
+
+Tile &tile_at(int x, int y) { return tiles[tile_index(x, y)]; }
+
+// Gives a tile its per-cell arrays. Only the master occupies tiles, between
+// days.
+void occupy(Tile &tile) {
+  if (tile.occupied) {
+    return;
+  }
+  int cells = tile.width * tile.height;
+  if (cohort_mode) {
+    tile.cohorts = CohortStore(cells);
+  } else {
+    tile.dandelions = DandelionStore(cells);
+  }
+  tile.density.assign(cells, 0);
+  tile.occupied = true;
+  active_tiles.push_back(tile_index(tile.x, tile.y));
+}
+
+// Counter of field cell (x, y), whose tile has to be occupied
+std::int64_t &grid_cell(int x, int y) {
+  Tile &tile = tile_at(x, y);
+  return tile.density[(y - tile.y) * tile.width + (x - tile.x)];
+}
+
+void mark_sent(Worker &worker, std::size_t t) {
+  if (!worker.sent[t]) {
+    worker.sent[t] = true;
+    worker.sent_tiles.push_back(t);
+  }
+}
+
+// Puts a seed landing on field cell (x, y) in a worker's outbox
+void send_seed(Worker &worker, int x, int y, const Dandelion &dand,
+               std::uint64_t source) {
+  std::size_t t = tile_index(x, y);
+  const Tile &tile = tiles[t];
+  worker.outboxes[t].push_back({{x - tile.x, y - tile.y}, dand, source});
+  mark_sent(worker, t);
+}
+
+// Counts n seeds landing on field cell (x, y) into a worker's seed_counts
+void count_seed(Worker &worker, int x, int y, std::uint64_t n) {
+  std::size_t t = tile_index(x, y);
+  const Tile &tile = tiles[t];
+  PopulationVector<std::uint64_t> &counts = worker.seed_counts[t];
+  if (counts.empty()) {
+    counts.resize(tile.width * tile.height);
+  }
+  counts[(y - tile.y) * tile.width + (x - tile.x)] += n;
+  mark_sent(worker, t);
+}
+
+// Each day the workers first advance the occupied tiles, then deliver the
+// seeds sent to each tile into it. Step does both for a pipelined day: each
+// tile gets the previous day's seeds and is then advanced. Jobs runs
+// run_jobs' job instead.
+enum class Phase { Advance, Deliver, Step, Jobs };
+
+// The workers are a persistent pool. The master sets phase and bumps step to
+// start a phase, and waits for workers_done to reach the number of workers.
+// Both sides spin for a while before sleeping on a futex, so a short phase
+// hands over in microseconds.
+Phase phase = Phase::Advance;
+std::atomic<std::uint32_t> step = 0;
+std::atomic<std::uint32_t> workers_done = 0;
+bool workers_exit = false;
+// spinning only pays with a core for each side
+bool spin_waits = false;
+constexpr int spin_limit = 4000;
+
+#if !defined(__linux__)
+std::mutex wait_mutex;
+std::condition_variable wait_cv;
+#endif
+
+inline void cpu_relax() {
+#if defined(__x86_64__) || defined(__i386__)
+  _mm_pause();
+#endif
+}
+
+// Returns once word no longer holds value
+void wait_while(std::atomic<std::uint32_t> &word, std::uint32_t value) {
+  for (int i = 0; spin_waits && i < spin_limit; ++i) {
+    if (word.load(std::memory_order_acquire) != value) {
+      return;
+    }
+    cpu_relax();
+  }
+  while (word.load(std::memory_order_acquire) == value) {
+#if defined(__linux__)
+    syscall(SYS_futex, &word, FUTEX_WAIT_PRIVATE, value, nullptr, nullptr, 0);
+#else
+    std::unique_lock lk(wait_mutex);
+    wait_cv.wait(lk, [&word, value] {
+      return word.load(std::memory_order_acquire) != value;
+    });
+#endif
+  }
+}
+
+// Wakes whoever waits on word, after it has been changed
+void wake_all(std::atomic<std::uint32_t> &word) {
+#if defined(__linux__)
+  syscall(SYS_futex, &word, FUTEX_WAKE_PRIVATE, INT_MAX, nullptr, nullptr, 0);
+#else
+  { std::lock_guard lk(wait_mutex); }
+  wait_cv.notify_all();
+#endif
+}
+
+void start_phase(Phase p) {
+  phase = p;
+  workers_done.store(0, std::memory_order_relaxed);
+  step.fetch_add(1, std::memory_order_release);
+  wake_all(step);
+}
+
+void wait_phase() {
+  while (true) {
+    std::uint32_t done = workers_done.load(std::memory_order_acquire);
+    if (done == workers.size()) {
+      return;
+    }
+    wait_while(workers_done, done);
+  }
+}
+
+// the Jobs phase's job, called with each index below job_count once
+std::size_t job_count = 0;
+std::atomic<std::size_t> next_job = 0;
+void (*job_function)(void *, std::size_t) = nullptr;
+void *job_context = nullptr;
+
+// Runs job(i) for every i in [0, n) on the pool and waits for them. The jobs
+// must not depend on which worker runs them or in what order.
+template <typename F> void run_jobs(std::size_t n, F job) {
+  job_count = n;
+  next_job.store(0, std::memory_order_relaxed);
+  job_context = &job;
+  job_function = [](void *context, std::size_t i) {
+    (*static_cast<F *>(context))(i);
+  };
+  start_phase(Phase::Jobs);
+  wait_phase();
+}
+
+// tiles seeds were sent to on sent_day, and whether a pipelined day left them
+// for the next one
+std::vector<std::size_t> delivery_tiles;
+std::uint64_t sent_day = 1;
+bool births_pending = false;
+
+std::atomic<std::uint64_t> day = 1;
+std::atomic<bool> should_close = false;
+std::atomic<bool> paused = false;
+bool headless = false;
+// snapshot dates as days since 1970-01-01
+std::vector<std::int32_t> snap_days;
+
+// Every operator new on the master and worker threads is counted, and
+// --allocs prints how many each day made. Scratch buffers keep their capacity
+// between days, so a day that does not grow the population should make none.
+// The window thread's allocations are not the simulation's.
+std::atomic<std::uint64_t> allocations = 0;
+thread_local bool counts_allocations = false;
+bool print_allocations = false;
+// --memory-limit in bytes, 0 for none. A run whose storage outgrows it stops.
+std::size_t memory_limit = 0;
+
+std::string megabytes(std::size_t bytes) {
+  return fmt::format("{:.1f} MB", bytes / (1024.0 * 1024.0));
+}
+
+void *operator new(std::size_t size) {
+  if (counts_allocations) {
+    allocations.fetch_add(1, std::memory_order_relaxed);
+  }
+  if (void *p = std::malloc(size == 0 ? 1 : size)) {
+    return p;
+  }
+  throw std::bad_alloc();
+}
+void operator delete(void *p) noexcept { std::free(p); }
+void operator delete(void *p, std::size_t) noexcept { std::free(p); }
+
+constexpr int humidities[4][5] = {{73, 70, 87, 60, 49},
+                                  {79, 50, 88, 58, 53},
+                                  {90, 48, 89, 50, 58},
+                                  {86, 57, 89, 62, 49}};
+constexpr float lights[4][5] = {
+    {2.0f + (1.0f / 6.0f), 8.5f, 10.0f + (5.0f / 6.0f), 9.5f, 10.5f},
+    {17.5f, 13.0f + (1.0f / 6.0f), 11.5f, 12.25f, 11.0f + (5.0f / 6.0f)},
+    {22.25f, 15.75f, 10.0f + (52.0f / 60.0f), 13.25f, 13.0f + (5.0f / 6.0f)},
+    {13.0f, 10.0f + (2.0f / 3.0f), 10.75f, 11.75f, 11.25f}};
+
+enum class Climate { Polar = 0, Continental, Tropical, Desert, Temperate };
+std::atomic<Climate> climate = Climate::Temperate;
+enum class Season { Winter = 0, Spring, Summer, Autumn };
+const std::string season_strings[] = {"Winter", "Spring", "Summer", "Autumn"};
+
+// One weather driven health change. Subtractions wrap like the uint8_t health
+// they are applied to, additions clamp at 100.
+struct HealthStep {
+  std::uint8_t amount;
+  bool add;
+};
+
+// Everything handle_dandelion derives from the day's weather, which is the
+// same for every dandelion
+struct DayEffect {
+  HealthStep steps[6];
+  int step_count = 0;
+  bool ages = false;
+  // The steps' net effect on each health. The wrapping subtractions make it
+  // no single clamped add, so it is a table, padded for 32-bit gathers.
+  std::uint8_t health_after[256 + 3] = {};
+
+  void add(std::uint8_t amount) { steps[step_count++] = {amount, true}; }
+  void sub(std::uint8_t amount) { steps[step_count++] = {amount, false}; }
+
+  // Fills in health_after once the steps are all added
+  void tabulate() {
+    for (int h = 0; h < 256; ++h) {
+      std::uint8_t health = h;
+      for (int s = 0; s < step_count; ++s) {
+        if (steps[s].add) {
+          health = clamp(health + steps[s].amount, 0, 100);
+        } else {
+          health -= steps[s].amount;
+        }
+      }
+      health_after[h] = health;
+    }
+  }
+
+  std::uint8_t apply(std::uint8_t health) const {
+    return health_after[health];
+  }
+};
+
+// Weather comes from a CSV file, or from a binary file made from one with
+// --convert. That is weather_magic, the number of days as a uint64 and a
+// WeatherRecord per day, in the machine's byte order. It is mapped into
+// memory while the environments are worked out from it, and unmapped after.
+struct WeatherRecord {
+  // days since 1970-01-01
+  std::int32_t day;
+  float temperature;
+  float precipitation;
+  std::int32_t wind_dir;
+  float wind_speed;
+};
+static_assert(sizeof(WeatherRecord) == 20);
+constexpr char weather_magic[8] = {'D', 'W', 'E', 'A', 'T', 'H', '0', '1'};
+constexpr std::size_t weather_header = 16;
+
+// A binary weather file in memory
+struct MappedWeather {
+  const WeatherRecord *records = nullptr;
+  std::size_t days = 0;
+  void *base = nullptr;
+  std::size_t bytes = 0;
+};
+
+// A day of weather and everything the day derives from it, worked out for the
+// whole series before the run starts
+struct Environment {
+  // days since 1970-01-01
+  std::int32_t day = 0;
+  std::string date;
+  Season season = Season::Winter;
+  float temperature = 0.0f;
+  float precipitation = 0.0f;
+  int wind_dir = 0;
+  float wind_speed = 0.0f;
+  int humidity = 0;
+  float light = 0.0f;
+  DayEffect effect;
+};
+
+std::vector<Environment> environments;
+// index of the next day's environment
+std::size_t weather_index = 0;
+// today's, set by the master between days. Workers only see it as a const
+// reference.
+const Environment *environment = nullptr;
+// shown before the first day
+const Environment no_weather = {};
+
+// Days since 1970-01-01 of a YYYY-MM-DD date (Hinnant's days_from_civil), or
+// INT32_MIN if it is not one
+std::int32_t parse_date(const std::string &text) {
+  int y, m, d;
+  if (std::sscanf(text.c_str(), "%d-%d-%d", &y, &m, &d) != 3 || m < 1 ||
+      m > 12 || d < 1 || d > 31) {
+    return INT32_MIN;
+  }
+  y -= m <= 2;
+  int era = (y >= 0 ? y : y - 399) / 400;
+  int yoe = y - era * 400;
+  int doy = (153 * (m > 2 ? m - 3 : m + 9) + 2) / 5 + d - 1;
+  int doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+  return era * 146097 + doe - 719468;
+}
+
+// YYYY-MM-DD date of a day since 1970-01-01 (Hinnant's civil_from_days)
+std::string format_date(std::int32_t day) {
+  int z = day + 719468;
+  int era = (z >= 0 ? z : z - 146096) / 146097;
+  int doe = z - era * 146097;
+  int yoe = (doe - doe / 1460 + doe / 36524 - doe / 146096) / 365;
+  int doy = doe - (365 * yoe + yoe / 4 - yoe / 100);
+  int mp = (5 * doy + 2) / 153;
+  int d = doy - (153 * mp + 2) / 5 + 1;
+  int m = mp < 10 ? mp + 3 : mp - 9;
+  int y = yoe + era * 400 + (m <= 2);
+  return fmt::format("{:04}-{:02}-{:02}", y, m, d);
+}
+
+// Reads every day of a CSV weather file
+bool read_csv_weather(const char *path, std::vector<WeatherRecord> &records) {
+  io::CSVReader<5> csv(path);
+  csv.read_header(io::ignore_extra_column | io::ignore_missing_column, "date",
+                  "tavg", "prcp", "wdir", "wspd");
+  std::string text;
+  WeatherRecord record;
+  while (csv.read_row(text, record.temperature, record.precipitation,
+                      record.wind_dir, record.wind_speed)) {
+    record.day = parse_date(text);
+    if (record.day == INT32_MIN) {
+      std::cout << "Bad date " << text << " in " << path << std::endl;
+      return false;
+    }
+    records.push_back(record);
+  }
+  return true;
+}
+
+// Writes the weather of a CSV file as a binary weather file
+bool convert_weather(const char *csv_path, const char *out_path) {
+  std::vector<WeatherRecord> records;
+  if (!read_csv_weather(csv_path, records)) {
+    return false;
+  }
+  std::ofstream out(out_path, std::ios::binary);
+  std::uint64_t count = records.size();
+  out.write(weather_magic, sizeof(weather_magic));
+  out.write(reinterpret_cast<const char *>(&count), sizeof(count));
+  out.write(reinterpret_cast<const char *>(records.data()),
+            records.size() * sizeof(WeatherRecord));
+  if (!out) {
+    std::cout << "Could not write " << out_path << std::endl;
+    return false;
+  }
+  std::cout << "Wrote " << count << " days to " << out_path << std::endl;
+  return true;
+}
+
+// Maps a binary weather file into mapped. False if the file is not one, or
+// is broken, which error says.
+bool map_weather(const char *path, MappedWeather &mapped, bool &error) {
+  error = false;
+  char head[weather_header];
+  std::ifstream probe(path, std::ios::binary);
+  if (!probe.read(head, weather_header) ||
+      std::memcmp(head, weather_magic, sizeof(weather_magic)) != 0) {
+    return false;
+  }
+  probe.close();
+  std::uint64_t count;
+  std::memcpy(&count, head + sizeof(weather_magic), sizeof(count));
+  auto cut_short = [path, &error]() {
+    std::cout << "Could not map " << path << ", or it is cut short"
+              << std::endl;
+    error = true;
+    return false;
+  };
+  // no file holds more records than fit in memory
+  if (count > (SIZE_MAX - weather_header) / sizeof(WeatherRecord)) {
+    return cut_short();
+  }
+  std::size_t bytes = weather_header + count * sizeof(WeatherRecord);
+  char *data = nullptr;
+#if defined(__unix__) || defined(__APPLE__)
+  int fd = open(path, O_RDONLY);
+  struct stat st;
+  if (fd >= 0 && fstat(fd, &st) == 0 &&
+      static_cast<std::size_t>(st.st_size) >= bytes) {
+    void *map = mmap(nullptr, bytes, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (map != MAP_FAILED) {
+      data = static_cast<char *>(map);
+    }
+  }
+  if (fd >= 0) {
+    close(fd);
+  }
+#else
+  std::ifstream in(path, std::ios::binary);
+  in.seekg(0, std::ios::end);
+  if (in && static_cast<std::size_t>(in.tellg()) >= bytes) {
+    data = static_cast<char *>(std::malloc(bytes));
+    in.seekg(0);
+    if (data && !in.read(data, bytes)) {
+      std::free(data);
+      data = nullptr;
+    }
+  }
+#endif
+  if (!data) {
+    return cut_short();
+  }
+  mapped.records =
+      reinterpret_cast<const WeatherRecord *>(data + weather_header);
+  mapped.days = count;
+  mapped.base = data;
+  mapped.bytes = bytes;
+  return true;
+}
+
+void unmap_weather(MappedWeather &mapped) {
+#if defined(__unix__) || defined(__APPLE__)
+  munmap(mapped.base, mapped.bytes);
+#else
+  std::free(mapped.base);
+#endif
+  mapped = MappedWeather();
+}
+
+Environment make_environment(const WeatherRecord &record) {
+  Environment env;
+  env.day = record.day;
+  env.date = format_date(record.day);
+  env.temperature = record.temperature;
+  env.precipitation = record.precipitation;
+  env.wind_dir = record.wind_dir;
+  env.wind_speed = record.wind_speed;
+  int month = (env.date[5] - 48) * 10 + (env.date[6] - 48);
+  if (month == 12 || month == 1 || month == 2) {
+    env.season = Season::Winter;
+  } else if (month >= 3 && month <= 5) {
+    env.season = Season::Spring;
+  } else if (month >= 6 && month <= 8) {
+    env.season = Season::Summer;
+  } else {
+    env.season = Season::Autumn;
+  }
+  env.humidity = humidities[static_cast<int>(env.season)]
+                           [static_cast<int>(climate.load())];
+  env.light =
+      lights[static_cast<int>(env.season)][static_cast<int>(climate.load())];
+
+  DayEffect &effect = env.effect;
+  if (env.precipitation < 0.7f) {
+    effect.sub(5);
+  } else if (env.precipitation >= 0.7f && env.precipitation <= 1.4f) {
+    effect.sub(2);
+  } else {
+    effect.add(1);
+  }
+
+  effect.ages = env.temperature >= 5.0f;
+  if (env.temperature > 40.0f) {
+    effect.sub(7);
+  } else if (env.temperature > 30.0f) {
+    effect.sub(1);
+  } else if (env.temperature < 10.0f) {
+    effect.sub(1);
+  } else {
+    effect.add(2);
+  }
+
+  if (env.temperature > 30.0f && env.humidity < 60.0f) {
+    effect.sub(2);
+  }
+  if (env.humidity < 40.0f) {
+    effect.sub(2);
+  }
+  if (env.humidity >= 40.0f && env.humidity <= 80.0f) {
+    effect.add(1);
+  }
+
+  if (env.light < 9.0f) {
+    effect.sub(1);
+  }
+  effect.tabulate();
+  return env;
+}
+
+// Loads a binary or CSV weather file and works out the environment of each
+// of its days, for the climate set. False, having said why, if it is broken.
+bool load_weather(const char *path) {
+  bool error;
+  MappedWeather mapped;
+  std::vector<WeatherRecord> csv_records;
+  const WeatherRecord *records = nullptr;
+  std::size_t days = 0;
+  if (map_weather(path, mapped, error)) {
+    records = mapped.records;
+    days = mapped.days;
+  } else if (!error && read_csv_weather(path, csv_records)) {
+    records = csv_records.data();
+    days = csv_records.size();
+  } else {
+    return false;
+  }
+  environments.reserve(days);
+  for (std::size_t d = 0; d < days; ++d) {
+    environments.push_back(make_environment(records[d]));
+  }
+  if (mapped.base) {
+    unmap_weather(mapped);
+  }
+  return true;
+}
+
+// What the window and the snapshots show of a day. The master fills one in at
+// the end of each day and publishes it whole, so nothing outside the master
+// reads live simulation state.
+struct Frame {
+  std::uint64_t day = 1;
+  std::uint64_t total = 0;
+  // environments do not change once loaded, so frames can point at them
+  const Environment *weather = &no_weather;
+  // per tile, empty for tiles that were not occupied
+  std::vector<PopulationVector<std::int64_t>> density;
+
+  std::int64_t count(int x, int y) const {
+    std::size_t t = tile_index(x, y);
+    if (density[t].empty()) {
+      return 0;
+    }
+    const Tile &tile = tiles[t];
+    return density[t][(y - tile.y) * tile.width + (x - tile.x)];
+  }
+};
+
+// Triple buffer: the master fills frames[back_frame], then swaps it with the
+// middle one and marks that fresh. The window swaps its frames[front_frame]
+// with the middle one when it is fresh. Neither ever waits for the other.
+Frame frames[3];
+constexpr int fresh_frame = 4;
+std::atomic<int> middle_frame = 1;
+int back_frame = 0;
+int front_frame = 2;
+
+// Fills in the day and weather of the master's frame
+Frame &start_frame() {
+  Frame &frame = frames[back_frame];
+  frame.day = day;
+  frame.weather = environment ? environment : &no_weather;
+  frame.density.resize(tiles.size());
+  return frame;
+}
+
+// Fills in the master's frame from the simulation as it is now
+Frame &fill_frame() {
+  Frame &frame = start_frame();
+  frame.total = total_dandelion_number;
+  for (std::size_t t : active_tiles) {
+    frame.density[t] = tiles[t].density;
+  }
+  return frame;
+}
+
+void publish_frame() {
+  back_frame = middle_frame.exchange(back_frame | fresh_frame,
+                                     std::memory_order_acq_rel) &
+               ~fresh_frame;
+}
+
+// The newest frame the master has published, for the window thread
+const Frame &latest_frame() {
+  if (middle_frame.load(std::memory_order_relaxed) & fresh_frame) {
+    front_frame =
+        middle_frame.exchange(front_frame, std::memory_order_acq_rel) &
+        ~fresh_frame;
+  }
+  return frames[front_frame];
+}
+
+// Philox streams of a cell past the ones of its dandelions, which are numbered
+// by their index in the cell
+constexpr std::uint32_t seeds_stream = 0xFFFFFFFF;
+constexpr std::uint32_t births_stream = 0xFFFFFFFE;
+constexpr std::uint32_t cohorts_stream = 0xFFFFFFFD;
+constexpr std::uint32_t dispersal_stream = 0xFFFFFFFC;
+
+// Stream of field cell (x, y) on day d
+Philox cell_rng(int x, int y, std::uint32_t stream, std::uint64_t d) {
+  return Philox(run_seed, d, y * segments + x, stream);
+}
+
+// Today's stream of field cell (x, y)
+Philox cell_rng(int x, int y, std::uint32_t stream) {
+  return cell_rng(x, y, stream, day);
+}
+
+// 0: nothing, 1: seeds, 2: die
+int handle_dandelion(DandelionStore &pop, std::size_t i, Philox &rng,
+                     const DayEffect &effect) {
+  auto &stage = pop.stage[i];
+  auto &days_since_last_stage = pop.days_since_last_stage[i];
+  auto &health = pop.health[i];
+  int rc = 0;
+  if (effective_time(pop.germination_time[i], health) == 0 ||
+      effective_time(pop.mature_time[i], health) == 0 ||
+      effective_time(pop.wither_time[i], health) == 0 ||
+      effective_time(pop.puffball_time[i], health) == 0 ||
+      effective_time(pop.sub_mature_time[i], health) == 0) {
+    return 2;
+  }
+  if (stage == Dandelion::Stage::Germinating) {
+    if (days_since_last_stage >=
+        effective_time(pop.germination_time[i], health)) {
+      stage = Dandelion::Stage::Maturing;
+      days_since_last_stage = 0;
+      health += 50;
+    }
+    int eaten_roll = draw(hundred_dist, rng);
+    if (eaten_roll <= seedling_eaten_chance /
+                          effective_time(pop.germination_time[i], health)) {
+      return 2;
+    }
+  } else if (stage == Dandelion::Stage::Maturing) {
+    if (days_since_last_stage >= effective_time(pop.mature_time[i], health)) {
+      stage = Dandelion::Stage::Flowering;
+      days_since_last_stage = 0;
+    }
+  } else if (stage == Dandelion::Stage::Flowering) {
+    if (days_since_last_stage >= effective_time(pop.flower_time[i], health)) {
+      stage = Dandelion::Stage::Withering;
+      days_since_last_stage = 0;
+    }
+  } else if (stage == Dandelion::Stage::Withering) {
+    if (days_since_last_stage >= effective_time(pop.wither_time[i], health)) {
+      stage = Dandelion::Stage::Puffball;
+      days_since_last_stage = 0;
+    }
+  } else if (stage == Dandelion::Stage::Puffball) {
+    if (days_since_last_stage >=
+        effective_time(pop.puffball_time[i], health)) {
+      stage = Dandelion::Stage::SubsequentMaturing;
+      days_since_last_stage = 0;
+      rc = 1;
+    }
+  } else {
+    if (days_since_last_stage >=
+        effective_time(pop.sub_mature_time[i], health)) {
+      stage = Dandelion::Stage::Flowering;
+      days_since_last_stage = 0;
+    }
+  }
+
+  if (effect.ages) {
+    pop.age[i]++;
+    days_since_last_stage++;
+  }
+  health = effect.apply(health);
+
+  if (health <= 0) {
+    return 2;
+  }
+  return rc;
+}
+
+// Lifecycle kernels advance a batch of dandelions by one day without touching
+// the RNG. They give each dandelion the same result as handle_dandelion, except
+// that germinating dandelions get lifecycle_eaten_roll set and their eaten
+// chance stored, and the roll is left to finish_lifecycle.
+constexpr std::uint8_t lifecycle_eaten_roll = 4;
+
+struct LifecycleBatch {
+  std::uint16_t *age;
+  std::uint16_t *days_since_last_stage;
+  Dandelion::Stage *stage;
+  std::uint8_t *health;
+  const std::uint8_t *germination_time;
+  const std::uint8_t *mature_time;
+  const std::uint8_t *flower_time;
+  const std::uint8_t *wither_time;
+  const std::uint8_t *puffball_time;
+  const std::uint16_t *sub_mature_time;
+  std::uint8_t *rc;
+  std::uint8_t *eaten_chance;
+};
+
+LifecycleBatch make_batch(DandelionStore &pop, std::uint8_t *rc,
+                          std::uint8_t *eaten_chance) {
+  return {pop.age.data(),
+          pop.days_since_last_stage.data(),
+          pop.stage.data(),
+          pop.health.data(),
+          pop.germination_time.data(),
+          pop.mature_time.data(),
+          pop.flower_time.data(),
+          pop.wither_time.data(),
+          pop.puffball_time.data(),
+          pop.sub_mature_time.data(),
+          rc,
+          eaten_chance};
+}
+
+using LifecycleKernel = void (*)(const LifecycleBatch &batch, std::size_t n,
+                                 const DayEffect &effect);
+
+// nullptr runs handle_dandelion on each dandelion instead
+LifecycleKernel lifecycle_kernel = nullptr;
+
+int finish_lifecycle(std::uint8_t rc, std::uint8_t eaten_chance,
+                     Philox &rng) {
+  if (rc & lifecycle_eaten_roll) {
+    int eaten_roll = draw(hundred_dist, rng);
+    if (eaten_roll <= eaten_chance) {
+      return 2;
+    }
+    rc &= ~lifecycle_eaten_roll;
+  }
+  return rc;
+}
+
+// Runs the last n % lanes dandelions of a batch through block by copying them
+// into zero padded lanes
+template <std::size_t lanes, typename Block>
+void lifecycle_tail(const LifecycleBatch &batch, std::size_t begin,
+                    std::size_t n, const DayEffect &effect, Block block) {
+  std::size_t count = n - begin;
+  if (count == 0) {
+    return;
+  }
+  std::uint16_t age[lanes] = {};
+  std::uint16_t days_since_last_stage[lanes] = {};
+  Dandelion::Stage stage[lanes] = {};
+  std::uint8_t health[lanes] = {};
+  std::uint8_t germination_time[lanes] = {};
+  std::uint8_t mature_time[lanes] = {};
+  std::uint8_t flower_time[lanes] = {};
+  std::uint8_t wither_time[lanes] = {};
+  std::uint8_t puffball_time[lanes] = {};
+  std::uint16_t sub_mature_time[lanes] = {};
+  std::uint8_t rc[lanes] = {};
+  std::uint8_t eaten_chance[lanes] = {};
+  for (std::size_t i = 0; i < count; ++i) {
+    age[i] = batch.age[begin + i];
+    days_since_last_stage[i] = batch.days_since_last_stage[begin + i];
+    stage[i] = batch.stage[begin + i];
+    health[i] = batch.health[begin + i];
+    germination_time[i] = batch.germination_time[begin + i];
+    mature_time[i] = batch.mature_time[begin + i];
+    flower_time[i] = batch.flower_time[begin + i];
+    wither_time[i] = batch.wither_time[begin + i];
+    puffball_time[i] = batch.puffball_time[begin + i];
+    sub_mature_time[i] = batch.sub_mature_time[begin + i];
+  }
+  LifecycleBatch tail = {age,
+                         days_since_last_stage,
+                         stage,
+                         health,
+                         germination_time,
+                         mature_time,
+                         flower_time,
+                         wither_time,
+                         puffball_time,
+                         sub_mature_time,
+                         rc,
+                         eaten_chance};
+  block(tail, 0, effect);
+  for (std::size_t i = 0; i < count; ++i) {
+    batch.age[begin + i] = age[i];
+    batch.days_since_last_stage[begin + i] = days_since_last_stage[i];
+    batch.stage[begin + i] = stage[i];
+    batch.health[begin + i] = health[i];
+    batch.rc[begin + i] = rc[i];
+    batch.eaten_chance[begin + i] = eaten_chance[i];
+  }
+}
+
+#if defined(__x86_64__) || defined(__i386__)
+
+__attribute__((target("avx2"))) inline __m256i
+load8_u8(const void *p) {
+  return _mm256_cvtepu8_epi32(_mm_loadl_epi64(static_cast<const __m128i *>(p)));
+}
+
+__attribute__((target("avx2"))) inline __m256i
+load8_u16(const void *p) {
+  return _mm256_cvtepu16_epi32(
+      _mm_loadu_si128(static_cast<const __m128i *>(p)));
+}
+
+__attribute__((target("avx2"))) inline void store8_u16(void *p, __m256i v) {
+  __m128i packed = _mm_packus_epi32(_mm256_castsi256_si128(v),
+                                    _mm256_extracti128_si256(v, 1));
+  _mm_storeu_si128(static_cast<__m128i *>(p), packed);
+}
+
+__attribute__((target("avx2"))) inline void store8_u8(void *p, __m256i v) {
+  __m128i packed = _mm_packus_epi32(_mm256_castsi256_si128(v),
+                                    _mm256_extracti128_si256(v, 1));
+  _mm_storel_epi64(static_cast<__m128i *>(p), _mm_packus_epi16(packed, packed));
+}
+
+// effective_time for 8 dandelions, given scale = 1 - (50 - health) / 100
+__attribute__((target("avx2"))) inline __m256i
+effective_time8(__m256i time, __m256 scale, __m256i healthy) {
+  __m256i scaled =
+      _mm256_cvttps_epi32(_mm256_mul_ps(scale, _mm256_cvtepi32_ps(time)));
+  return _mm256_and_si256(_mm256_blendv_epi8(scaled, time, healthy),
+                          _mm256_set1_epi32(0xff));
+}
+
+__attribute__((target("avx2"))) inline __m256 health_scale8(__m256i health) {
+  return _mm256_sub_ps(
+      _mm256_set1_ps(1.0f),
+      _mm256_div_ps(
+          _mm256_cvtepi32_ps(_mm256_sub_epi32(_mm256_set1_epi32(50), health)),
+          _mm256_set1_ps(100.0f)));
+}
+
+__attribute__((target("avx2"))) void
+lifecycle_block_avx2(const LifecycleBatch &batch, std::size_t i,
+                     const DayEffect &effect) {
+  const __m256i zero = _mm256_setzero_si256();
+  __m256i stage = load8_u8(batch.stage + i);
+  __m256i health = load8_u8(batch.health + i);
+  __m256i days = load8_u16(batch.days_since_last_stage + i);
+  __m256i age = load8_u16(batch.age + i);
+
+  __m256i healthy = _mm256_cmpgt_epi32(health, _mm256_set1_epi32(49));
+  __m256 scale = health_scale8(health);
+  __m256i germination =
+      effective_time8(load8_u8(batch.germination_time + i), scale, healthy);
+  __m256i mature =
+      effective_time8(load8_u8(batch.mature_time + i), scale, healthy);
+  __m256i flower =
+      effective_time8(load8_u8(batch.flower_time + i), scale, healthy);
+  __m256i wither =
+      effective_time8(load8_u8(batch.wither_time + i), scale, healthy);
+  __m256i puffball =
+      effective_time8(load8_u8(batch.puffball_time + i), scale, healthy);
+  __m256i sub_mature =
+      effective_time8(load8_u16(batch.sub_mature_time + i), scale, healthy);
+
+  __m256i no_time = _mm256_or_si256(
+      _mm256_or_si256(_mm256_cmpeq_epi32(germination, zero),
+                      _mm256_cmpeq_epi32(mature, zero)),
+      _mm256_or_si256(_mm256_or_si256(_mm256_cmpeq_epi32(wither, zero),
+                                      _mm256_cmpeq_epi32(puffball, zero)),
+                      _mm256_cmpeq_epi32(sub_mature, zero)));
+
+  __m256i germinating = _mm256_cmpeq_epi32(stage, _mm256_set1_epi32(0));
+  __m256i puffing = _mm256_cmpeq_epi32(stage, _mm256_set1_epi32(4));
+  __m256i subsequent = _mm256_cmpeq_epi32(stage, _mm256_set1_epi32(5));
+  __m256i stage_time = sub_mature;
+  stage_time = _mm256_blendv_epi8(stage_time, germination, germinating);
+  stage_time = _mm256_blendv_epi8(
+      stage_time, mature, _mm256_cmpeq_epi32(stage, _mm256_set1_epi32(1)));
+  stage_time = _mm256_blendv_epi8(
+      stage_time, flower, _mm256_cmpeq_epi32(stage, _mm256_set1_epi32(2)));
+  stage_time = _mm256_blendv_epi8(
+      stage_time, wither, _mm256_cmpeq_epi32(stage, _mm256_set1_epi32(3)));
+  stage_time = _mm256_blendv_epi8(stage_time, puffball, puffing);
+
+  __m256i advance = _mm256_xor_si256(_mm256_cmpgt_epi32(stage_time, days),
+                                     _mm256_set1_epi32(-1));
+  __m256i next = _mm256_blendv_epi8(
+      _mm256_add_epi32(stage, _mm256_set1_epi32(1)), _mm256_set1_epi32(2),
+      subsequent);
+  stage = _mm256_blendv_epi8(stage, next, advance);
+  days = _mm256_andnot_si256(advance, days);
+  health = _mm256_and_si256(
+      _mm256_add_epi32(health,
+                       _mm256_and_si256(_mm256_and_si256(germinating, advance),
+                                        _mm256_set1_epi32(50))),
+      _mm256_set1_epi32(0xff));
+  __m256i seeds = _mm256_and_si256(puffing, advance);
+
+  __m256i eaten_roll = _mm256_andnot_si256(no_time, germinating);
+  __m256i germination_now =
+      effective_time8(load8_u8(batch.germination_time + i),
+                      health_scale8(health),
+                      _mm256_cmpgt_epi32(health, _mm256_set1_epi32(49)));
+  __m256i eaten_chance = _mm256_and_si256(
+      eaten_roll,
+      _mm256_cvttps_epi32(_mm256_div_ps(
+          _mm256_set1_ps(static_cast<float>(seedling_eaten_chance)),
+          _mm256_cvtepi32_ps(
+              _mm256_max_epi32(germination_now, _mm256_set1_epi32(1))))));
+
+  if (effect.ages) {
+    age = _mm256_and_si256(_mm256_add_epi32(age, _mm256_set1_epi32(1)),
+                           _mm256_set1_epi32(0xffff));
+    days = _mm256_and_si256(_mm256_add_epi32(days, _mm256_set1_epi32(1)),
+                            _mm256_set1_epi32(0xffff));
+  }
+  health = _mm256_and_si256(
+      _mm256_i32gather_epi32(
+          reinterpret_cast<const int *>(effect.health_after), health, 1),
+      _mm256_set1_epi32(0xff));
+
+  __m256i dies = _mm256_or_si256(no_time, _mm256_cmpeq_epi32(health, zero));
+  __m256i rc = _mm256_blendv_epi8(
+      _mm256_and_si256(seeds, _mm256_set1_epi32(1)), _mm256_set1_epi32(2),
+      dies);
+  rc = _mm256_or_si256(rc, _mm256_and_si256(
+                               eaten_roll,
+                               _mm256_set1_epi32(lifecycle_eaten_roll)));
+
+  store8_u8(batch.stage + i, stage);
+  store8_u8(batch.health + i, health);
+  store8_u16(batch.days_since_last_stage + i, days);
+  store8_u16(batch.age + i, age);
+  store8_u8(batch.rc + i, rc);
+  store8_u8(batch.eaten_chance + i, eaten_chance);
+}
+
+__attribute__((target("avx2"))) void
+lifecycle_avx2(const LifecycleBatch &batch, std::size_t n,
+               const DayEffect &effect) {
+  std::size_t i = 0;
+  for (; i + 8 <= n; i += 8) {
+    lifecycle_block_avx2(batch, i, effect);
+  }
+  lifecycle_tail<8>(batch, i, n, effect, lifecycle_block_avx2);
+}
+
+__attribute__((target("sse4.1"))) inline __m128i load4_u8(const void *p) {
+  std::int32_t bytes;
+  std::memcpy(&bytes, p, sizeof(bytes));
+  return _mm_cvtepu8_epi32(_mm_cvtsi32_si128(bytes));
+}
+
+__attribute__((target("sse4.1"))) inline __m128i load4_u16(const void *p) {
+  return _mm_cvtepu16_epi32(_mm_loadl_epi64(static_cast<const __m128i *>(p)));
+}
+
+__attribute__((target("sse4.1"))) inline void store4_u16(void *p, __m128i v) {
+  _mm_storel_epi64(static_cast<__m128i *>(p), _mm_packus_epi32(v, v));
+}
+
+__attribute__((target("sse4.1"))) inline void store4_u8(void *p, __m128i v) {
+  __m128i packed = _mm_packus_epi32(v, v);
+  std::int32_t bytes = _mm_cvtsi128_si32(_mm_packus_epi16(packed, packed));
+  std::memcpy(p, &bytes, sizeof(bytes));
+}
+
+__attribute__((target("sse4.1"))) inline __m128i
+effective_time4(__m128i time, __m128 scale, __m128i healthy) {
+  __m128i scaled = _mm_cvttps_epi32(_mm_mul_ps(scale, _mm_cvtepi32_ps(time)));
+  return _mm_and_si128(_mm_blendv_epi8(scaled, time, healthy),
+                       _mm_set1_epi32(0xff));
+}
+
+__attribute__((target("sse4.1"))) inline __m128 health_scale4(__m128i health) {
+  return _mm_sub_ps(
+      _mm_set1_ps(1.0f),
+      _mm_div_ps(_mm_cvtepi32_ps(_mm_sub_epi32(_mm_set1_epi32(50), health)),
+                 _mm_set1_ps(100.0f)));
+}
+
+__attribute__((target("sse4.1"))) void
+lifecycle_block_sse41(const LifecycleBatch &batch, std::size_t i,
+                      const DayEffect &effect) {
+  const __m128i zero = _mm_setzero_si128();
+  __m128i stage = load4_u8(batch.stage + i);
+  __m128i health = load4_u8(batch.health + i);
+  __m128i days = load4_u16(batch.days_since_last_stage + i);
+  __m128i age = load4_u16(batch.age + i);
+
+  __m128i healthy = _mm_cmpgt_epi32(health, _mm_set1_epi32(49));
+  __m128 scale = health_scale4(health);
+  __m128i germination =
+      effective_time4(load4_u8(batch.germination_time + i), scale, healthy);
+  __m128i mature =
+      effective_time4(load4_u8(batch.mature_time + i), scale, healthy);
+  __m128i flower =
+      effective_time4(load4_u8(batch.flower_time + i), scale, healthy);
+  __m128i wither =
+      effective_time4(load4_u8(batch.wither_time + i), scale, healthy);
+  __m128i puffball =
+      effective_time4(load4_u8(batch.puffball_time + i), scale, healthy);
+  __m128i sub_mature =
+      effective_time4(load4_u16(batch.sub_mature_time + i), scale, healthy);
+
+  __m128i no_time = _mm_or_si128(
+      _mm_or_si128(_mm_cmpeq_epi32(germination, zero),
+                   _mm_cmpeq_epi32(mature, zero)),
+      _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi32(wither, zero),
+                                _mm_cmpeq_epi32(puffball, zero)),
+                   _mm_cmpeq_epi32(sub_mature, zero)));
+
+  __m128i germinating = _mm_cmpeq_epi32(stage, _mm_set1_epi32(0));
+  __m128i puffing = _mm_cmpeq_epi32(stage, _mm_set1_epi32(4));
+  __m128i subsequent = _mm_cmpeq_epi32(stage, _mm_set1_epi32(5));
+  __m128i stage_time = sub_mature;
+  stage_time = _mm_blendv_epi8(stage_time, germination, germinating);
+  stage_time = _mm_blendv_epi8(stage_time, mature,
+                               _mm_cmpeq_epi32(stage, _mm_set1_epi32(1)));
+  stage_time = _mm_blendv_epi8(stage_time, flower,
+                               _mm_cmpeq_epi32(stage, _mm_set1_epi32(2)));
+  stage_time = _mm_blendv_epi8(stage_time, wither,
+                               _mm_cmpeq_epi32(stage, _mm_set1_epi32(3)));
+  stage_time = _mm_blendv_epi8(stage_time, puffball, puffing);
+
+  __m128i advance =
+      _mm_xor_si128(_mm_cmpgt_epi32(stage_time, days), _mm_set1_epi32(-1));
+  __m128i next = _mm_blendv_epi8(_mm_add_epi32(stage, _mm_set1_epi32(1)),
+                                 _mm_set1_epi32(2), subsequent);
+  stage = _mm_blendv_epi8(stage, next, advance);
+  days = _mm_andnot_si128(advance, days);
+  health = _mm_and_si128(
+      _mm_add_epi32(health, _mm_and_si128(_mm_and_si128(germinating, advance),
+                                          _mm_set1_epi32(50))),
+      _mm_set1_epi32(0xff));
+  __m128i seeds = _mm_and_si128(puffing, advance);
+
+  __m128i eaten_roll = _mm_andnot_si128(no_time, germinating);
+  __m128i germination_now = effective_time4(
+      load4_u8(batch.germination_time + i), health_scale4(health),
+      _mm_cmpgt_epi32(health, _mm_set1_epi32(49)));
+  __m128i eaten_chance = _mm_and_si128(
+      eaten_roll,
+      _mm_cvttps_epi32(_mm_div_ps(
+          _mm_set1_ps(static_cast<float>(seedling_eaten_chance)),
+          _mm_cvtepi32_ps(_mm_max_epi32(germination_now, _mm_set1_epi32(1))))));
+
+  if (effect.ages) {
+    age = _mm_and_si128(_mm_add_epi32(age, _mm_set1_epi32(1)),
+                        _mm_set1_epi32(0xffff));
+    days = _mm_and_si128(_mm_add_epi32(days, _mm_set1_epi32(1)),
+                         _mm_set1_epi32(0xffff));
+  }
+  const std::uint8_t *after = effect.health_after;
+  health = _mm_setr_epi32(after[_mm_extract_epi32(health, 0)],
+                          after[_mm_extract_epi32(health, 1)],
+                          after[_mm_extract_epi32(health, 2)],
+                          after[_mm_extract_epi32(health, 3)]);
+
+  __m128i dies = _mm_or_si128(no_time, _mm_cmpeq_epi32(health, zero));
+  __m128i rc = _mm_blendv_epi8(_mm_and_si128(seeds, _mm_set1_epi32(1)),
+                               _mm_set1_epi32(2), dies);
+  rc = _mm_or_si128(
+      rc, _mm_and_si128(eaten_roll, _mm_set1_epi32(lifecycle_eaten_roll)));
+
+  store4_u8(batch.stage + i, stage);
+  store4_u8(batch.health + i, health);
+  store4_u16(batch.days_since_last_stage + i, days);
+  store4_u16(batch.age + i, age);
+  store4_u8(batch.rc + i, rc);
+  store4_u8(batch.eaten_chance + i, eaten_chance);
+}
+
+__attribute__((target("sse4.1"))) void
+lifecycle_sse41(const LifecycleBatch &batch, std::size_t n,
+                const DayEffect &effect) {
+  std::size_t i = 0;
+  for (; i + 4 <= n; i += 4) {
+    lifecycle_block_sse41(batch, i, effect);
+  }
+  lifecycle_tail<4>(batch, i, n, effect, lifecycle_block_sse41);
+}
+
+#endif
+
+// Picks the widest kernel the CPU supports, or the one named by --kernel
+LifecycleKernel select_lifecycle_kernel(const std::string &name) {
+#if defined(__x86_64__) || defined(__i386__)
+  __builtin_cpu_init();
+  bool has_avx2 = __builtin_cpu_supports("avx2");
+  bool has_sse41 = __builtin_cpu_supports("sse4.1");
+  if ((name.empty() || name == "avx2") && has_avx2) {
+    return lifecycle_avx2;
+  }
+  if ((name.empty() || name == "avx2" || name == "sse4.1") && has_sse41) {
+    return lifecycle_sse41;
+  }
+#endif
+  return nullptr;
+}
+
+// Where the day's seeds land relative to their puffball. A seed flies a
+// normally distributed distance, rounded to whole cells, at a normally
+// distributed angle around the wind, rounded to whole degrees. The kernel
+// lists every offset that can come out of that with its probability, and
+// samples them through an alias table (Vose).
+struct DispersalKernel {
+  // furthest any offset goes along either axis
+  int reach;
+  // sorted by falling probability
+  std::vector<GridCoords> offsets;
+  std::vector<double> probability;
+  std::vector<float> keep_chance;
+  std::vector<std::uint32_t> alias;
+
+  // One draw picks both the column, in the high half of draw * size, and
+  // where it falls within the column, in the low half
+  std::uint32_t pick(Philox &rng) const {
+    std::uint64_t m = static_cast<std::uint64_t>(rng()) * offsets.size();
+    std::uint32_t i = m >> 32;
+    float u = static_cast<std::uint32_t>(m) * 0x1.0p-32f;
+    return u < keep_chance[i] ? i : alias[i];
+  }
+  GridCoords sample(Philox &rng) const { return offsets[pick(rng)]; }
+};
+
+// Chance of a normal distribution rounding to k
+double rounding_chance(double mean, double stddev, int k) {
+  auto below = [mean, stddev](double x) {
+    return 0.5 * std::erfc((mean - x) / (stddev * M_SQRT2));
+  };
+  return below(k + 0.5) - below(k - 0.5);
+}
+
+// Rebuilds kernel for a day's wind. Its storage and the scratch buffers are
+// reused from day to day.
+void make_dispersal_kernel(DispersalKernel &kernel, const Environment &env) {
+  static std::vector<double> angle_chance;
+  static std::vector<float> sines;
+  static std::vector<float> cosines;
+  static std::vector<double> chance;
+  static std::vector<int> order;
+  static std::vector<double> scaled;
+  static std::vector<std::uint32_t> small;
+  static std::vector<std::uint32_t> large;
+
+  // everything further than 7 standard deviations out is dropped
+  float speed = 3.0f * env.wind_speed / 3.6f;
+  double dist_mean = wind_dist_dist.mean() + speed;
+  double dist_stddev = wind_dist_dist.stddev();
+  int dist_min = std::floor(dist_mean - 7.0 * dist_stddev);
+  int dist_max = std::ceil(dist_mean + 7.0 * dist_stddev);
+  double angle_stddev = wind_angle_dist_normal.stddev();
+  int angle_reach = std::ceil(7.0 * angle_stddev);
+  int reach = std::max(std::abs(dist_min), std::abs(dist_max));
+  int side = 2 * reach + 1;
+
+  int angles = 2 * angle_reach + 1;
+  angle_chance.resize(angles);
+  sines.resize(angles);
+  cosines.resize(angles);
+  for (int k = -angle_reach; k <= angle_reach; ++k) {
+    int angle = k + env.wind_dir;
+    angle_chance[k + angle_reach] = rounding_chance(0.0, angle_stddev, k);
+    sines[k + angle_reach] = std::sin(angle * DEG2RAD);
+    cosines[k + angle_reach] = std::cos(angle * DEG2RAD);
+  }
+
+  chance.assign(side * side, 0.0);
+  for (int dist = dist_min; dist <= dist_max; ++dist) {
+    double dist_chance = rounding_chance(dist_mean, dist_stddev, dist);
+    for (int a = 0; a < angles; ++a) {
+      // the same float math that used to run per seed
+      int movex = std::round(dist * sines[a]);
+      int movey = std::round(dist * cosines[a]);
+      chance[(movey + reach) * side + movex + reach] +=
+          dist_chance * angle_chance[a];
+    }
+  }
+
+  order.clear();
+  double total = 0.0;
+  for (int i = 0; i < side * side; ++i) {
+    if (chance[i] > 0.0) {
+      order.push_back(i);
+      total += chance[i];
+    }
+  }
+  std::sort(order.begin(), order.end(), [](int a, int b) {
+    return chance[a] > chance[b] || (chance[a] == chance[b] && a < b);
+  });
+  kernel.reach = reach;
+  kernel.offsets.clear();
+  kernel.probability.clear();
+  for (int i : order) {
+    kernel.offsets.push_back({i % side - reach, i / side - reach});
+    kernel.probability.push_back(chance[i]);
+  }
+  std::size_t n = kernel.offsets.size();
+  kernel.keep_chance.resize(n);
+  kernel.alias.resize(n);
+  scaled.resize(n);
+  small.clear();
+  large.clear();
+  for (std::size_t i = 0; i < n; ++i) {
+    kernel.probability[i] /= total;
+    scaled[i] = kernel.probability[i] * n;
+    (scaled[i] < 1.0 ? small : large).push_back(i);
+  }
+  while (!small.empty() && !large.empty()) {
+    std::uint32_t s = small.back();
+    std::uint32_t l = large.back();
+    small.pop_back();
+    kernel.keep_chance[s] = scaled[s];
+    kernel.alias[s] = l;
+    scaled[l] -= 1.0 - scaled[s];
+    if (scaled[l] < 1.0) {
+      large.pop_back();
+      small.push_back(l);
+    }
+  }
+  for (std::uint32_t i : small) {
+    kernel.keep_chance[i] = 1.0f;
+    kernel.alias[i] = i;
+  }
+  for (std::uint32_t i : large) {
+    kernel.keep_chance[i] = 1.0f;
+    kernel.alias[i] = i;
+  }
+}
+
+// set by the master at the start of each day
+DispersalKernel dispersal_kernel;
+
+// scatter_seeds draws a binomial for the next offset while there are at least
+// this many seeds left per offset still to go, weighted by their chance
+constexpr double multinomial_seeds = 8.0;
+
+// In counts mode, after a day on which enough cells released seeds for it to
+// be cheaper, the released seeds are spread by convolve_seeds instead
+bool convolving = false;
+
+// Fills in the stage_classes probabilities and checked_durations from the
+// distributions new dandelions draw their stage durations from
+void init_duration_classes() {
+  auto normal = [](const std::normal_distribution<float> &dist) {
+    std::vector<double> chance(256);
+    auto below = [&dist](double x) {
+      return 0.5 *
+             std::erfc((dist.mean() - x) / (dist.stddev() * std::sqrt(2.0)));
+    };
+    // durations are truncated into integers
+    for (int t = 0; t < 256; ++t) {
+      chance[t] = below(t + 1) - below(t);
+    }
+    return chance;
+  };
+  std::vector<double> durations[6] = {
+      normal(germination_dist), normal(mature_dist),  normal(flower_dist),
+      normal(wither_dist),      normal(puffball_dist),
+      std::vector<double>(sub_mature_dist.b() + 1)};
+  for (int t = sub_mature_dist.a(); t <= sub_mature_dist.b(); ++t) {
+    durations[5][t] = 1.0 / (sub_mature_dist.b() - sub_mature_dist.a() + 1);
+  }
+
+  for (int s = 0; s < 6; ++s) {
+    for (std::size_t t = 0; t < durations[s].size(); ++t) {
+      stage_classes[s].probability[stage_classes[s].classify(t)] +=
+          durations[s][t];
+    }
+  }
+  int checked = 0;
+  for (int s : {0, 1, 3, 4, 5}) {
+    CheckedDurations &stage = checked_durations[checked++];
+    stage.chance = durations[s];
+    for (int health = 0; health < 256; ++health) {
+      for (std::size_t t = 0; t < durations[s].size(); ++t) {
+        if (effective_time(t, health) == 0) {
+          stage.zero[health].push_back(t);
+        }
+      }
+    }
+  }
+}
+
+// Chance that a dandelion that passed the zero stage time check at every
+// health in checked fails it at health. Its durations are fixed, so the check
+// only kills those whose durations fail at health but passed at all of those.
+double zero_time_death(const std::bitset<256> &checked, std::uint8_t health) {
+  thread_local std::vector<std::uint8_t> failed;
+  int healths[256];
+  int count = 0;
+  for (int h = 0; h < 256; ++h) {
+    if (checked[h]) {
+      healths[count++] = h;
+    }
+  }
+  // chances of passing at every checked health, and at health as well
+  double passed = 1.0;
+  double passes = 1.0;
+  for (const CheckedDurations &stage : checked_durations) {
+    failed.assign(stage.chance.size(), 0);
+    double before = 0.0;
+    for (int i = 0; i < count; ++i) {
+      for (std::uint16_t t : stage.zero[healths[i]]) {
+        if (!failed[t]) {
+          failed[t] = 1;
+          before += stage.chance[t];
+        }
+      }
+    }
+    double after = before;
+    for (std::uint16_t t : stage.zero[health]) {
+      if (!failed[t]) {
+        failed[t] = 1;
+        after += stage.chance[t];
+      }
+    }
+    passed *= 1.0 - before;
+    passes *= 1.0 - after;
+  }
+  if (passed <= 0.0) {
+    return 1.0;
+  }
+  return std::max(1.0 - passes / passed, 0.0);
+}
+
+// Total seeds released by n puffballs
+std::uint64_t seed_total(std::uint64_t n, Philox &rng) {
+  std::uint64_t seeds = 0;
+  if (n <= 32) {
+    for (std::uint64_t i = 0; i < n; ++i) {
+      seeds += draw(seeds_dist, rng);
+    }
+    return seeds;
+  }
+  double width = seeds_dist.b() - seeds_dist.a() + 1;
+  double mean = n * (seeds_dist.a() + seeds_dist.b()) / 2.0;
+  double stddev = std::sqrt(n * (width * width - 1.0) / 12.0);
+  double total =
+      std::round(std::normal_distribution<double>(mean, stddev)(rng));
+  return std::clamp(total, static_cast<double>(n) * seeds_dist.a(),
+                    static_cast<double>(n) * seeds_dist.b());
+}
+
+std::uint64_t binomial(std::uint64_t n, double p, Philox &rng) {
+  if (n == 0 || p <= 0.0) {
+    return 0;
+  }
+  if (p >= 1.0) {
+    return n;
+  }
+  return std::binomial_distribution<std::uint64_t>(n, p)(rng);
+}
 
-  inline std::uint8_t egermination_time() {
-    if (health >= 50) {
-      return germination_time;
+// Scatters n seeds released in one cell over the day's dispersal kernel,
+// calling land(offset, count) for each offset that gets seeds. This is a
+// multinomial draw: a binomial per offset, likeliest first, while there are
+// enough seeds left for that to beat sampling them one by one from the rest
+// of the kernel.
+template <typename F> void scatter_seeds(std::uint64_t n, Philox &rng, F land) {
+  const DispersalKernel &kernel = dispersal_kernel;
+  std::size_t size = kernel.offsets.size();
+  std::size_t i = 0;
+  double left = 1.0;
+  for (; i < size && n > 0 && n >= multinomial_seeds * left * (size - i); ++i) {
+    double p = kernel.probability[i];
+    std::uint64_t landed = p < left ? binomial(n, p / left, rng) : n;
+    if (landed > 0) {
+      land(kernel.offsets[i], landed);
     }
-    return (1.0f - static_cast<float>(50 - health) / 100.0f) * germination_time;
+    n -= landed;
+    left -= p;
   }
-  inline std::uint8_t emature_time() {
-    if (health >= 50) {
-      return mature_time;
+  // seeds drawn onto the offsets already done are drawn again
+  for (; n > 0; --n) {
+    std::uint32_t k = kernel.pick(rng);
+    while (k < i) {
+      k = kernel.pick(rng);
     }
-    return (1.0f - static_cast<float>(50 - health) / 100.0f) * mature_time;
+    land(kernel.offsets[k], 1);
   }
-  inline std::uint8_t eflower_time() {
-    if (health >= 50) {
-      return flower_time;
+}
+
+// Cohort counterpart of handle_dandelion. Members whose stage ends today are
+// moved into advanced, and the members that died and the seeds released are
+// added to deaths and seeds.
+void handle_cohort(Cohort &cohort, Cohort &advanced, std::uint64_t &deaths,
+                   std::uint64_t &seeds, Philox &rng,
+                   const DayEffect &effect) {
+  int stage = static_cast<int>(cohort.stage);
+  const DurationClasses &classes = stage_classes[stage];
+  bool germinating = cohort.stage == Dandelion::Stage::Germinating;
+
+  advanced = Cohort();
+  advanced.age = cohort.age;
+  advanced.stage = cohort.stage == Dandelion::Stage::SubsequentMaturing
+                       ? Dandelion::Stage::Flowering
+                       : static_cast<Dandelion::Stage>(stage + 1);
+  advanced.health = germinating ? cohort.health + 50 : cohort.health;
+  advanced.is_first = cohort.is_first;
+
+  // durations are fixed per dandelion, so the members that fail the check at
+  // this health already died if it ran at this health before
+  double zero_time =
+      cohort.checked_health[cohort.health]
+          ? 0.0
+          : zero_time_death(cohort.checked_health, cohort.health);
+  cohort.checked_health[cohort.health] = true;
+  advanced.checked_health = cohort.checked_health;
+
+  std::uint64_t remaining = 0;
+  for (int k = 0; k < duration_classes; ++k) {
+    std::uint64_t n = cohort.members[k];
+    if (n == 0) {
+      continue;
+    }
+    std::uint64_t died = binomial(n, zero_time, rng);
+    n -= died;
+    bool advance = cohort.days_since_last_stage >=
+                   effective_time(classes.duration(k), cohort.health);
+    if (germinating && n > 0) {
+      std::uint8_t health = advance ? advanced.health : cohort.health;
+      int eaten_chance =
+          seedling_eaten_chance / effective_time(classes.duration(k), health);
+      std::uint64_t eaten = binomial(n, eaten_chance / 100.0, rng);
+      n -= eaten;
+      died += eaten;
+    }
+    deaths += died;
+    if (advance) {
+      advanced.count += n;
+      cohort.members[k] = 0;
+    } else {
+      cohort.members[k] = n;
+      remaining += n;
     }
-    return (1.0f - static_cast<float>(50 - health) / 100.0f) * flower_time;
   }
-  inline std::uint8_t ewither_time() {
-    if (health >= 50) {
-      return wither_time;
+  cohort.count = remaining;
+
+  for (Cohort *c : {&cohort, &advanced}) {
+    if (effect.ages) {
+      c->age++;
+      c->days_since_last_stage++;
+    }
+    c->health = effect.apply(c->health);
+    if (c->health == 0 && c->count > 0) {
+      deaths += c->count;
+      c->count = 0;
     }
-    return (1.0f - static_cast<float>(50 - health) / 100.0f) * wither_time;
   }
-  inline std::uint8_t epuffball_time() {
-    if (health >= 50) {
-      return puffball_time;
+
+  // members that die today release no seeds, as in handle_dandelion
+  if (advanced.count > 0) {
+    if (cohort.stage == Dandelion::Stage::Puffball) {
+      std::uint64_t released = seed_total(advanced.count, rng);
+      if (cohort.is_first) {
+        released /= ratio;
+      }
+      seeds += released;
     }
-    return (1.0f - static_cast<float>(50 - health) / 100.0f) * puffball_time;
+    sample_classes(stage_classes[static_cast<int>(advanced.stage)],
+                   advanced.count, advanced.members, rng);
   }
-  inline std::uint8_t esub_mature_time() {
-    if (health >= 50) {
-      return sub_mature_time;
+}
+
+// Merges the cohorts from first on that have the same stage, days in it,
+// health and is_first. Their age becomes the mean age, and only the healths
+// both were checked at stay checked.
+void merge_cohorts(PopulationVector<Cohort> &cohorts, std::size_t first) {
+  auto key = [](const Cohort &c) {
+    return std::make_tuple(c.stage, c.days_since_last_stage, c.health,
+                           c.is_first);
+  };
+  std::sort(cohorts.begin() + first, cohorts.end(),
+            [&key](const Cohort &a, const Cohort &b) {
+              return key(a) < key(b);
+            });
+  std::size_t kept = first;
+  for (std::size_t i = first; i < cohorts.size(); ++i) {
+    Cohort &cohort = cohorts[i];
+    if (kept > first && key(cohorts[kept - 1]) == key(cohort)) {
+      Cohort &into = cohorts[kept - 1];
+      into.checked_health &= cohort.checked_health;
+      std::uint64_t count = into.count + cohort.count;
+      into.age = (static_cast<std::uint64_t>(into.age) * into.count +
+                  static_cast<std::uint64_t>(cohort.age) * cohort.count) /
+                 count;
+      into.count = count;
+      for (int k = 0; k < duration_classes; ++k) {
+        into.members[k] += cohort.members[k];
+      }
+    } else {
+      cohorts[kept++] = cohort;
     }
-    return (1.0f - static_cast<float>(50 - health) / 100.0f) * sub_mature_time;
   }
-};
+  cohorts.resize(kept);
+}
 
-struct GridCoords {
-  int x, y;
-};
-struct NewSeed {
-  GridCoords coords;
-  Dandelion dandelion;
-};
+// Advances the cohorts of a tile by one day, counting released seeds into the
+// worker's seed_counts
+void advance_cohorts(Tile &tile, Worker &worker, const Environment &env) {
+  CohortStore &grid = tile.cohorts;
+  grid.next.clear();
+  if (convolving) {
+    tile.released.assign(tile.width * tile.height, 0);
+  }
+  for (int y = tile.y; y < tile.y + tile.height; ++y) {
+    for (int x = tile.x; x < tile.x + tile.width; ++x) {
+      int cell = (y - tile.y) * tile.width + (x - tile.x);
+      std::size_t first = grid.next.size();
+      grid.next_start[cell] = first;
+      std::uint64_t deaths = 0;
+      std::uint64_t seeds = 0;
+      Philox rng = cell_rng(x, y, cohorts_stream);
+      for (std::uint32_t i = grid.cell_start[cell];
+           i < grid.cell_start[cell + 1]; ++i) {
+        Cohort cohort = grid.cohorts[i];
+        Cohort advanced;
+        handle_cohort(cohort, advanced, deaths, seeds, rng, env.effect);
+        if (cohort.count > 0) {
+          grid.next.push_back(cohort);
+        }
+        if (advanced.count > 0) {
+          grid.next.push_back(advanced);
+        }
+      }
+      merge_cohorts(grid.next, first);
+      if (seeds > 0) {
+        worker.releasing_cells++;
+      }
+      if (convolving) {
+        tile.released[cell] = seeds;
+      } else {
+        scatter_seeds(seeds, rng, [&](GridCoords seed, std::uint64_t n) {
+          GridCoords new_coords = {x + seed.x, y - seed.y};
+          if (new_coords.x < 0 || new_coords.y < 0 ||
+              new_coords.x >= segments || new_coords.y >= segments) {
+            return;
+          }
+          count_seed(worker, new_coords.x, new_coords.y, n);
+        });
+      }
+      tile.density[cell] -= deaths * ratio;
+      worker.population_change -= deaths * ratio;
+    }
+  }
+  grid.next_start[tile.width * tile.height] = grid.next.size();
+  grid.swap();
+}
 
-std::atomic<int> full_grid[segments][segments];
-std::atomic<std::uint64_t> total_dandelion_number = 0;
+// Advances the dandelions of a tile by one day
+void advance_dandelions(Tile &tile, Worker &worker, const Environment &env) {
+  DandelionStore &grid = tile.dandelions;
+  std::vector<std::uint8_t> &rcs = worker.rcs;
+  std::vector<std::uint8_t> &eaten_chances = worker.eaten_chances;
+  if (lifecycle_kernel) {
+    rcs.resize(grid.size());
+    eaten_chances.resize(grid.size());
+    lifecycle_kernel(make_batch(grid, rcs.data(), eaten_chances.data()),
+                     grid.size(), env.effect);
+  }
+  if (convolving) {
+    tile.released.assign(tile.width * tile.height, 0);
+  }
+  std::uint32_t kept = 0;
+  std::uint32_t begin = grid.cell_start[0];
+  for (int y = tile.y; y < tile.y + tile.height; ++y) {
+    for (int x = tile.x; x < tile.x + tile.width; ++x) {
+      int cell = (y - tile.y) * tile.width + (x - tile.x);
+      std::uint32_t end = grid.cell_start[cell + 1];
+      grid.cell_start[cell] = kept;
+      int deaths = 0;
+      // the seeds stream is separate from the dandelions' streams, so the
+      // puffballs draw their seeds as they go
+      Philox seeds_rng = cell_rng(x, y, seeds_stream);
+      std::uint64_t seeds = 0;
+      for (std::uint32_t i = begin; i < end; ++i) {
+        Philox rng = cell_rng(x, y, i - begin);
+        int rc = lifecycle_kernel
+                     ? finish_lifecycle(rcs[i], eaten_chances[i], rng)
+                     : handle_dandelion(grid, i, rng, env.effect);
+        if (rc == 2) {
+          deaths++;
+          continue;
+        } else if (rc == 1) {
+          int released = draw(seeds_dist, seeds_rng);
+          if (grid.is_first[i]) {
+            released /= ratio;
+          }
+          seeds += released;
+        }
+        // the survivors only start moving after the tile's first death
+        if (i != kept) {
+          grid.move(i, kept);
+        }
+        kept++;
+      }
+      begin = end;
+      std::uint64_t source = static_cast<std::uint64_t>(y * segments + x) << 32;
+      if (seeds > 0) {
+        worker.releasing_cells++;
+      }
+      if (convolving) {
+        tile.released[cell] = seeds;
+      } else {
+        scatter_seeds(seeds, seeds_rng, [&](GridCoords seed, std::uint64_t n) {
+          GridCoords new_coords = {x + seed.x, y - seed.y};
+          if (new_coords.x < 0 || new_coords.y < 0 ||
+              new_coords.x >= segments || new_coords.y >= segments) {
+            return;
+          }
+          if (dispersal == Dispersal::Counts) {
+            count_seed(worker, new_coords.x, new_coords.y, n);
+            return;
+          }
+          for (std::uint64_t j = 0; j < n; ++j) {
+            send_seed(worker, new_coords.x, new_coords.y,
+                      Dandelion(seeds_rng), source++);
+          }
+        });
+      }
+      tile.density[cell] -= deaths * ratio;
+      worker.population_change -= deaths * ratio;
+    }
+  }
+  grid.cell_start[tile.width * tile.height] = kept;
+  grid.resize(kept);
+}
 
-// top left
-std::mutex grid1_mutex;
-std::condition_variable cv1;
-std::atomic<int> cv1_state = 0;
-std::vector<Dandelion> grid1[segments / 2][segments / 2];
-std::queue<NewSeed> grid1_seed_queue;
-
-// top right
-std::mutex grid2_mutex;
-std::condition_variable cv2;
-std::atomic<int> cv2_state = 0;
-std::vector<Dandelion> grid2[segments / 2][segments / 2];
-std::queue<NewSeed> grid2_seed_queue;
-
-// bottom left
-std::mutex grid3_mutex;
-std::condition_variable cv3;
-std::atomic<int> cv3_state = 0;
-std::vector<Dandelion> grid3[segments / 2][segments / 2];
-std::queue<NewSeed> grid3_seed_queue;
-
-// bottom right
-std::mutex grid4_mutex;
-std::condition_variable cv4;
-std::atomic<int> cv4_state = 0;
-std::vector<Dandelion> grid4[segments / 2][segments / 2];
-std::queue<NewSeed> grid4_seed_queue;
+// Convolution dispersal. The seeds released per cell are convolved with the
+// day's kernel, directly or through an FFT, whichever is estimated to be
+// cheaper, into the seeds expected per cell. Those are rounded stochastically
+// into worker 0's seed_counts. Rounding keeps the expected seeds but not the
+// spread a multinomial draw has around them.
+
+// rough costs in nanoseconds of a seed scattered on its own, a kernel offset
+// of a releasing cell and an FFT butterfly
+constexpr double sample_cost = 9.0;
+constexpr double direct_cost = 4.0;
+constexpr double butterfly_cost = 5.0;
+// largest FFT side, which takes 64 MB
+constexpr std::size_t max_fft_side = 2048;
+
+PopulationVector<double> expected_seeds;
+PopulationVector<std::complex<double>> fft_buffer;
+PopulationVector<std::complex<double>> fft_twiddles;
+
+// std::complex's operator* checks for infinities, which is slow
+inline std::complex<double> multiply(std::complex<double> a,
+                                     std::complex<double> b) {
+  return {a.real() * b.real() - a.imag() * b.imag(),
+          a.real() * b.imag() + a.imag() * b.real()};
+}
 
-std::atomic<std::uint64_t> day = 1;
-std::atomic<bool> should_close = false;
-std::atomic<bool> paused = false;
-std::vector<std::string> snap_dates;
+// In-place radix-2 FFT of n values, with fft_twiddles set up for n. The
+// inverse is not scaled by 1 / n.
+void fft(std::complex<double> *a, std::size_t n, bool inverse) {
+  for (std::size_t i = 1, j = 0; i < n; ++i) {
+    std::size_t bit = n >> 1;
+    for (; j & bit; bit >>= 1) {
+      j ^= bit;
+    }
+    j ^= bit;
+    if (i < j) {
+      std::swap(a[i], a[j]);
+    }
+  }
+  for (std::size_t len = 2; len <= n; len <<= 1) {
+    std::size_t half = len / 2;
+    std::size_t step = n / len;
+    for (std::size_t i = 0; i < n; i += len) {
+      for (std::size_t k = 0; k < half; ++k) {
+        std::complex<double> w = fft_twiddles[k * step];
+        if (inverse) {
+          w = std::conj(w);
+        }
+        std::complex<double> u = a[i + k];
+        std::complex<double> v = multiply(a[i + k + half], w);
+        a[i + k] = u + v;
+        a[i + k + half] = u - v;
+      }
+    }
+  }
+}
 
-constexpr int humidities[4][5] = {{73, 70, 87, 60, 49},
-                                  {79, 50, 88, 58, 53},
-                                  {90, 48, 89, 50, 58},
-                                  {86, 57, 89, 62, 49}};
-constexpr float lights[4][5] = {
-    {2.0f + (1.0f / 6.0f), 8.5f, 10.0f + (5.0f / 6.0f), 9.5f, 10.5f},
-    {17.5f, 13.0f + (1.0f / 6.0f), 11.5f, 12.25f, 11.0f + (5.0f / 6.0f)},
-    {22.25f, 15.75f, 10.0f + (52.0f / 60.0f), 13.25f, 13.0f + (5.0f / 6.0f)},
-    {13.0f, 10.0f + (2.0f / 3.0f), 10.75f, 11.75f, 11.25f}};
+// Each row of blocks swaps its part above the diagonal with the column of
+// blocks below it, so the rows of blocks can go to different workers
+void transpose(PopulationVector<std::complex<double>> &a, std::size_t n) {
+  constexpr std::size_t block = 32;
+  run_jobs((n + block - 1) / block, [&a, n](std::size_t b) {
+    std::size_t by = b * block;
+    for (std::size_t bx = by; bx < n; bx += block) {
+      for (std::size_t y = by; y < std::min(by + block, n); ++y) {
+        for (std::size_t x = std::max(bx, y + 1); x < std::min(bx + block, n);
+             ++x) {
+          std::swap(a[y * n + x], a[x * n + y]);
+        }
+      }
+    }
+  });
+}
 
-enum class Climate { Polar = 0, Continental, Tropical, Desert, Temperate };
-std::atomic<Climate> climate = Climate::Temperate;
-std::string date;
-enum class Season { Winter = 0, Spring, Summer, Autumn };
-const std::string season_strings[] = {"Winter", "Spring", "Summer", "Autumn"};
-std::atomic<Season> season = Season::Winter;
-std::atomic<float> temperature = 0.0f;
-std::atomic<float> precipitation = 0.0f;
-std::atomic<int> wind_dir = 0;
-std::atomic<float> wind_speed = 0.0f;
-std::atomic<int> humidity = 0;
-std::atomic<float> light = 0.0f;
-float ntemperature;
-float nprecipitation;
-int nwind_dir;
-float nwind_speed;
+// 2D FFT of the n by n fft_buffer as row FFTs, a transpose and row FFTs again.
+// That leaves the result transposed, and the inverse transposes it back. Rows
+// from first_rows on are zero on the way in, and only the rows before
+// last_rows are needed on the way out.
+void fft2(std::size_t n, bool inverse, std::size_t first_rows,
+          std::size_t last_rows) {
+  auto row = [n, inverse](std::size_t y) {
+    fft(&fft_buffer[y * n], n, inverse);
+  };
+  run_jobs(first_rows, row);
+  transpose(fft_buffer, n);
+  run_jobs(last_rows, row);
+}
 
-// 0: nothing, 1: seeds, 2: die
-int handle_dandelion(Dandelion &dand, std::mt19937 &mt) {
-  int rc = 0;
-  if (dand.egermination_time() == 0 || dand.emature_time() == 0 ||
-      dand.ewither_time() == 0 || dand.epuffball_time() == 0 ||
-      dand.esub_mature_time() == 0) {
-    return 2;
+// Convolves the released field with the kernel in fft_buffer, an n by n
+// power of two with room for the kernel's reach on both sides. The released
+// seeds go in the real part and the kernel in the imaginary part, so one
+// forward FFT transforms both.
+void convolve_fft(std::size_t n) {
+  const DispersalKernel &kernel = dispersal_kernel;
+  int reach = kernel.reach;
+  fft_buffer.assign(n * n, 0.0);
+  if (fft_twiddles.size() != n / 2) {
+    fft_twiddles.resize(n / 2);
+    for (std::size_t k = 0; k < n / 2; ++k) {
+      fft_twiddles[k] = std::polar(1.0, -2.0 * M_PI * k / n);
+    }
   }
-  if (dand.stage == Dandelion::Stage::Germinating) {
-    if (dand.days_since_last_stage >= dand.egermination_time()) {
-      dand.stage = Dandelion::Stage::Maturing;
-      dand.days_since_last_stage = 0;
-      dand.health += 50;
+  run_jobs(active_tiles.size(), [n](std::size_t i) {
+    const Tile &tile = tiles[active_tiles[i]];
+    for (int y = 0; y < tile.height; ++y) {
+      for (int x = 0; x < tile.width; ++x) {
+        fft_buffer[(tile.y + y) * n + tile.x + x] =
+            static_cast<double>(tile.released[y * tile.width + x]);
+      }
     }
-    int eaten_roll = hundred_dist(mt);
-    if (eaten_roll <= seedling_eaten_chance / dand.egermination_time()) {
-      return 2;
+  });
+  for (std::size_t i = 0; i < kernel.offsets.size(); ++i) {
+    GridCoords offset = kernel.offsets[i];
+    fft_buffer[(reach - offset.y) * n + reach + offset.x].imag(
+        kernel.probability[i]);
+  }
+  std::size_t rows = std::max<std::size_t>(segments, 2 * reach + 1);
+  fft2(n, false, rows, n);
+  // with z = r + ik, r's transform at f is (z(f) + conj(z(-f))) / 2 and k's
+  // is (z(f) - conj(z(-f))) / 2i. The product at -f is the conjugate of the
+  // one at f, so each pair is done by the row of whichever comes first.
+  run_jobs(n, [n](std::size_t u) {
+    for (std::size_t v = 0; v < n; ++v) {
+      std::size_t f = u * n + v;
+      std::size_t g = ((n - u) % n) * n + (n - v) % n;
+      if (g < f) {
+        continue;
+      }
+      std::complex<double> a = fft_buffer[f];
+      std::complex<double> b = std::conj(fft_buffer[g]);
+      std::complex<double> r = (a + b) * 0.5;
+      std::complex<double> k = multiply(a - b, {0.0, -0.5});
+      fft_buffer[f] = multiply(r, k);
+      fft_buffer[g] = std::conj(fft_buffer[f]);
     }
-  } else if (dand.stage == Dandelion::Stage::Maturing) {
-    if (dand.days_since_last_stage >= dand.emature_time()) {
-      dand.stage = Dandelion::Stage::Flowering;
-      dand.days_since_last_stage = 0;
-    }
-  } else if (dand.stage == Dandelion::Stage::Flowering) {
-    if (dand.days_since_last_stage >= dand.eflower_time()) {
-      dand.stage = Dandelion::Stage::Withering;
-      dand.days_since_last_stage = 0;
-    }
-  } else if (dand.stage == Dandelion::Stage::Withering) {
-    if (dand.days_since_last_stage >= dand.ewither_time()) {
-      dand.stage = Dandelion::Stage::Puffball;
-      dand.days_since_last_stage = 0;
-    }
-  } else if (dand.stage == Dandelion::Stage::Puffball) {
-    if (dand.days_since_last_stage >= dand.epuffball_time()) {
-      dand.stage = Dandelion::Stage::SubsequentMaturing;
-      dand.days_since_last_stage = 0;
-      rc = 1;
+  });
+  fft2(n, true, n, reach + segments);
+}
+
+// Side of the FFT convolve_seeds uses with today's kernel
+std::size_t fft_side() {
+  std::size_t n = 1;
+  while (n < static_cast<std::size_t>(segments + 2 * dispersal_kernel.reach)) {
+    n <<= 1;
+  }
+  return n;
+}
+
+// Estimated nanoseconds convolve_seeds takes when releasing cells released
+// seeds, through the FFT if use_fft is set
+double convolve_cost(std::size_t releasing, bool &use_fft) {
+  std::size_t n = fft_side();
+  double direct = direct_cost * releasing * dispersal_kernel.offsets.size();
+  double fft =
+      butterfly_cost * 2.0 * n * n * std::log2(static_cast<double>(n));
+  use_fft = n <= max_fft_side && fft < direct;
+  return use_fft ? fft : direct;
+}
+
+// Spreads the seeds released in the active tiles today over the field,
+// releasing is how many cells released any
+void convolve_seeds(std::size_t releasing) {
+  const DispersalKernel &kernel = dispersal_kernel;
+  int reach = kernel.reach;
+  std::size_t n = fft_side();
+  bool use_fft;
+  convolve_cost(releasing, use_fft);
+
+  // the FFT leaves rounding noise everywhere, relative to the total
+  double least = 0.0;
+  if (use_fft) {
+    convolve_fft(n);
+    std::uint64_t total = 0;
+    for (std::size_t t : active_tiles) {
+      for (std::uint64_t seeds : tiles[t].released) {
+        total += seeds;
+      }
     }
+    least = total * 1e-13;
   } else {
-    if (dand.days_since_last_stage >= dand.esub_mature_time()) {
-      dand.stage = Dandelion::Stage::Flowering;
-      dand.days_since_last_stage = 0;
+    expected_seeds.assign(static_cast<std::size_t>(segments) * segments, 0.0);
+    // row major over the field, so the sums do not depend on the tiles
+    for (int y = 0; y < segments; ++y) {
+      for (int x = 0; x < segments; ++x) {
+        const Tile &tile = tile_at(x, y);
+        if (!tile.occupied) {
+          continue;
+        }
+        std::uint64_t seeds =
+            tile.released[(y - tile.y) * tile.width + (x - tile.x)];
+        if (seeds == 0) {
+          continue;
+        }
+        for (std::size_t i = 0; i < kernel.offsets.size(); ++i) {
+          int to_x = x + kernel.offsets[i].x;
+          int to_y = y - kernel.offsets[i].y;
+          if (to_x < 0 || to_y < 0 || to_x >= segments || to_y >= segments) {
+            continue;
+          }
+          expected_seeds[to_y * segments + to_x] +=
+              seeds * kernel.probability[i];
+        }
+      }
     }
   }
 
-  if (precipitation < 0.7f) {
-    dand.health -= 5;
-  } else if (precipitation >= 0.7f && precipitation <= 1.4f) {
-    dand.health -= 2;
-  } else {
-    dand.health = clamp(dand.health + 1, 0, 100);
+  double scale = 1.0 / (static_cast<double>(n) * n);
+  for (int y = 0; y < segments; ++y) {
+    for (int x = 0; x < segments; ++x) {
+      double expected =
+          use_fft ? fft_buffer[(y + reach) * n + x + reach].real() * scale
+                  : expected_seeds[y * segments + x];
+      if (expected <= least) {
+        continue;
+      }
+      Philox rng = cell_rng(x, y, dispersal_stream);
+      double whole = std::floor(expected);
+      std::uint64_t seeds = whole;
+      if (rng() * 0x1.0p-32 < expected - whole) {
+        seeds++;
+      }
+      if (seeds > 0) {
+        count_seed(workers[0], x, y, seeds);
+      }
+    }
   }
+}
+
+void insert_births(Tile &tile) {
+  tile.dandelions.insert(tile.births, tile.width);
+  tile.births.clear();
+}
 
-  if (temperature >= 5.0f) {
-    dand.age++;
-    dand.days_since_last_stage++;
+// Adds the seeds every worker sent to tile t on sent_day to it
+void deliver_seeds(std::size_t t, Worker &worker) {
+  Tile &tile = tiles[t];
+  if (!tile.receiving) {
+    return;
   }
-  if (temperature > 40.0f) {
-    dand.health -= 7;
-  } else if (temperature > 30.0f) {
-    dand.health -= 1;
-  } else if (temperature < 10.0f) {
-    dand.health -= 1;
+  tile.receiving = false;
+  PopulationVector<std::int64_t> &grid = tile.density;
+  std::uint64_t born = 0;
+  auto births_rng = [&tile](std::size_t c) {
+    return cell_rng(tile.x + c % tile.width, tile.y + c / tile.width,
+                    births_stream, sent_day);
+  };
+  if (dispersal == Dispersal::Counts) {
+    PopulationVector<std::uint64_t> &counts = worker.delivered_counts;
+    counts.assign(tile.width * tile.height, 0);
+    for (Worker &w : workers) {
+      PopulationVector<std::uint64_t> &sent =
+          pipelined ? w.sent_counts[t] : w.seed_counts[t];
+      for (std::size_t c = 0; c < sent.size(); ++c) {
+        counts[c] += sent[c];
+        sent[c] = 0;
+      }
+    }
+    for (std::size_t c = 0; c < counts.size(); ++c) {
+      grid[c] += counts[c] * ratio;
+      born += counts[c];
+    }
+    if (cohort_mode) {
+      tile.cohorts.insert_new(counts.data(), tile.width, tile.width,
+                              births_rng);
+    } else {
+      tile.dandelions.insert_new(counts.data(), tile.width, tile.width,
+                                 births_rng);
+    }
   } else {
-    dand.health = clamp(dand.health + 2, 0, 100);
+    for (Worker &w : workers) {
+      PopulationVector<NewSeed> &sent =
+          pipelined ? w.sent_outboxes[t] : w.outboxes[t];
+      tile.births.insert(tile.births.end(), sent.begin(), sent.end());
+      sent.clear();
+    }
+    std::sort(tile.births.begin(), tile.births.end(),
+              [](const NewSeed &a, const NewSeed &b) {
+                return a.source < b.source;
+              });
+    for (const NewSeed &seed : tile.births) {
+      grid[seed.coords.y * tile.width + seed.coords.x] += ratio;
+    }
+    born = tile.births.size();
+    insert_births(tile);
   }
+  worker.population_born += born * ratio;
+}
 
-  if (temperature > 30.0f && humidity < 60.0f) {
-    dand.health -= 2;
+// Rough cost of tile t in the current phase: its live records and the seeds
+// sent to it that the phase handles, plus its cells
+std::size_t tile_weight(std::size_t t) {
+  const Tile &tile = tiles[t];
+  std::size_t weight = tile.width * tile.height;
+  if (phase != Phase::Advance) {
+    for (const Worker &w : workers) {
+      weight += pipelined ? w.sent_outboxes[t].size() : w.outboxes[t].size();
+    }
   }
-  if (humidity < 40.0f) {
-    dand.health -= 2;
+  if (phase == Phase::Deliver) {
+    return weight;
   }
-  if (humidity >= 40.0f && humidity <= 80.0f) {
-    dand.health = clamp(dand.health + 1, 0, 100);
+  if (cohort_mode) {
+    weight += tile.cohorts.cohorts.size();
+  } else {
+    weight += tile.dandelions.size();
   }
+  return weight;
+}
 
-  if (light < 9.0f) {
-    dand.health -= 1;
+// Deals the tiles out heaviest first, each to the least loaded worker
+void schedule_tiles(const std::vector<std::size_t> &list) {
+  static std::vector<std::size_t> weights;
+  static std::vector<std::size_t> order;
+  static std::vector<std::size_t> loads;
+  weights.resize(tiles.size());
+  for (std::size_t t : list) {
+    weights[t] = tile_weight(t);
   }
-
-  if (dand.health <= 0) {
-    return 2;
+  order = list;
+  std::sort(order.begin(), order.end(), [](std::size_t a, std::size_t b) {
+    return weights[a] > weights[b];
+  });
+  loads.assign(workers.size(), 0);
+  for (Worker &w : workers) {
+    w.tile_queue.clear();
+    w.tile_front = 0;
+  }
+  for (std::size_t t : order) {
+    std::size_t w =
+        std::min_element(loads.begin(), loads.end()) - loads.begin();
+    workers[w].tile_queue.push_back(t);
+    loads[w] += weights[t];
   }
-  return rc;
-}
-
-GridCoords gen_seed(std::mt19937 &mt) {
-  int dist = std::round(wind_dist_dist(mt) +
-                        3.0f * static_cast<float>(wind_speed) / 3.6f);
-  int angle = std::round(wind_angle_dist_normal(mt)) + wind_dir;
-  int movex = std::round(dist * std::sin(angle * DEG2RAD));
-  int movey = std::round(dist * std::cos(angle * DEG2RAD));
-  return {movex, movey};
 }
 
-void worker1() {
-  while (true) {
-    std::unique_lock lk(grid1_mutex);
-    cv1.wait(lk, [] { return cv1_state == 1; });
-    if (should_close) {
-      break;
+// Takes the next tile from worker id's own queue, or steals one from another
+// worker once it runs dry
+bool next_tile(std::size_t id, std::size_t &t) {
+  for (std::size_t k = 0; k < workers.size(); ++k) {
+    Worker &w = workers[(id + k) % workers.size()];
+    std::lock_guard lk(w.tiles_mutex);
+    if (w.tile_front == w.tile_queue.size()) {
+      continue;
     }
-    std::deque<std::vector<Dandelion>::iterator> death_queue;
-    std::queue<std::vector<Dandelion>::iterator> puff_queue;
-    for (int y = 0; y < 50; ++y) {
-      for (int x = 0; x < 50; ++x) {
-        auto &vec = grid1[y][x];
-        for (auto i = vec.begin(); i < vec.end(); ++i) {
-          int rc = handle_dandelion(*i, mtrandom1);
-          if (rc == 2) {
-            death_queue.push_back(i);
-          } else if (rc == 1) {
-            puff_queue.push(i);
-          }
-        }
-        while (puff_queue.size() > 0) {
-          auto i = puff_queue.front();
-          puff_queue.pop();
-          int seeds = seeds_dist(mtrandom1);
-          if (i->is_first) {
-            seeds /= ratio;
-          }
-          for (int j = 0; j < seeds; ++j) {
-            GridCoords seed = gen_seed(mtrandom1);
-            GridCoords new_coords = {x + seed.x, y - seed.y};
-            if (new_coords.x < 0 || new_coords.y < 0 || new_coords.x > 99 ||
-                new_coords.y > 99) {
-              continue;
-            }
-            grid1_seed_queue.push({new_coords, Dandelion(mtrandom1)});
-            full_grid[new_coords.y][new_coords.x] += ratio;
-            total_dandelion_number += ratio;
-          }
-        }
-        while (death_queue.size() > 0) {
-          auto i = death_queue.back();
-          death_queue.pop_back();
-          vec.erase(i);
-          full_grid[y][x] -= ratio;
-          total_dandelion_number -= ratio;
-        }
-      }
+    if (k == 0) {
+      t = w.tile_queue[w.tile_front++];
+    } else {
+      t = w.tile_queue.back();
+      w.tile_queue.pop_back();
     }
-    cv1_state = 0;
-    lk.unlock();
-    cv1.notify_one();
+    return true;
   }
+  return false;
 }
-void worker2() {
+
+void worker(std::size_t id) {
+  counts_allocations = true;
+  std::uint32_t last_step = 0;
   while (true) {
-    std::unique_lock lk(grid2_mutex);
-    cv2.wait(lk, [] { return cv2_state == 1; });
-    if (should_close) {
+    wait_while(step, last_step);
+    last_step = step.load(std::memory_order_acquire);
+    if (workers_exit) {
       break;
     }
-    std::deque<std::vector<Dandelion>::iterator> death_queue;
-    std::queue<std::vector<Dandelion>::iterator> puff_queue;
-    for (int y = 0; y < 50; ++y) {
-      for (int x = 0; x < 50; ++x) {
-        auto &vec = grid2[y][x];
-        for (auto i = vec.begin(); i < vec.end(); ++i) {
-          int rc = handle_dandelion(*i, mtrandom2);
-          if (rc == 2) {
-            death_queue.push_back(i);
-          } else if (rc == 1) {
-            puff_queue.push(i);
-          }
-        }
-        while (puff_queue.size() > 0) {
-          auto i = puff_queue.front();
-          puff_queue.pop();
-          int seeds = seeds_dist(mtrandom2);
-          if (i->is_first) {
-            seeds /= ratio;
-          }
-          for (int j = 0; j < seeds; ++j) {
-            GridCoords seed = gen_seed(mtrandom2);
-            GridCoords new_coords = {x + 50 + seed.x, y - seed.y};
-            if (new_coords.x < 0 || new_coords.y < 0 || new_coords.x > 99 ||
-                new_coords.y > 99) {
-              continue;
-            }
-            grid2_seed_queue.push({new_coords, Dandelion(mtrandom2)});
-            full_grid[new_coords.y][new_coords.x] += ratio;
-            total_dandelion_number += ratio;
-          }
-        }
-        while (death_queue.size() > 0) {
-          auto i = death_queue.back();
-          death_queue.pop_back();
-          vec.erase(i);
-          full_grid[y][x + 50] -= ratio;
-          total_dandelion_number -= ratio;
-        }
+    if (phase == Phase::Jobs) {
+      std::size_t i;
+      while ((i = next_job.fetch_add(1, std::memory_order_relaxed)) <
+             job_count) {
+        job_function(job_context, i);
       }
     }
-    cv2_state = 0;
-    lk.unlock();
-    cv2.notify_one();
-  }
-}
-void worker3() {
-  while (true) {
-    std::unique_lock lk(grid3_mutex);
-    cv3.wait(lk, [] { return cv3_state == 1; });
-    if (should_close) {
-      break;
-    }
-    std::deque<std::vector<Dandelion>::iterator> death_queue;
-    std::queue<std::vector<Dandelion>::iterator> puff_queue;
-    for (int y = 0; y < 50; ++y) {
-      for (int x = 0; x < 50; ++x) {
-        auto &vec = grid3[y][x];
-        for (auto i = vec.begin(); i < vec.end(); ++i) {
-          int rc = handle_dandelion(*i, mtrandom3);
-          if (rc == 2) {
-            death_queue.push_back(i);
-          } else if (rc == 1) {
-            puff_queue.push(i);
-          }
-        }
-        while (puff_queue.size() > 0) {
-          auto i = puff_queue.front();
-          puff_queue.pop();
-          int seeds = seeds_dist(mtrandom3);
-          if (i->is_first) {
-            seeds /= ratio;
-          }
-          for (int j = 0; j < seeds; ++j) {
-            GridCoords seed = gen_seed(mtrandom3);
-            GridCoords new_coords = {x + seed.x, y + 50 - seed.y};
-            if (new_coords.x < 0 || new_coords.y < 0 || new_coords.x > 99 ||
-                new_coords.y > 99) {
-              continue;
-            }
-            grid3_seed_queue.push({new_coords, Dandelion(mtrandom3)});
-            full_grid[new_coords.y][new_coords.x] += ratio;
-            total_dandelion_number += ratio;
-          }
-        }
-        while (death_queue.size() > 0) {
-          auto i = death_queue.back();
-          death_queue.pop_back();
-          vec.erase(i);
-          full_grid[y + 50][x] -= ratio;
-          total_dandelion_number -= ratio;
-        }
+    std::size_t t;
+    while (phase != Phase::Jobs && next_tile(id, t)) {
+      if (phase == Phase::Deliver) {
+        deliver_seeds(t, workers[id]);
+        continue;
+      }
+      if (phase == Phase::Step) {
+        // the tile as the previous day left it goes into that day's frame
+        deliver_seeds(t, workers[id]);
+        frames[back_frame].density[t] = tiles[t].density;
+      }
+      if (cohort_mode) {
+        advance_cohorts(tiles[t], workers[id], *environment);
+      } else {
+        advance_dandelions(tiles[t], workers[id], *environment);
       }
     }
-    cv3_state = 0;
-    lk.unlock();
-    cv3.notify_one();
+    if (workers_done.fetch_add(1, std::memory_order_acq_rel) + 1 ==
+        workers.size()) {
+      wake_all(workers_done);
+    }
   }
 }
-void worker4() {
-  while (true) {
-    std::unique_lock lk(grid4_mutex);
-    cv4.wait(lk, [] { return cv4_state == 1; });
-    if (should_close) {
-      break;
+
+// Runs a phase over the listed tiles on the workers and waits for them to
+// finish it
+void run_workers(Phase p, const std::vector<std::size_t> &list) {
+  phase = p;
+  schedule_tiles(list);
+  start_phase(p);
+  wait_phase();
+}
+
+// Occupies the tiles any worker sent seeds to today and lists them in
+// delivery_tiles. Pipelined days move the outboxes aside for the next day to
+// deliver.
+void collect_deliveries() {
+  delivery_tiles.clear();
+  sent_day = day;
+  for (Worker &w : workers) {
+    for (std::size_t t : w.sent_tiles) {
+      w.sent[t] = false;
+      delivery_tiles.push_back(t);
     }
-    std::deque<std::vector<Dandelion>::iterator> death_queue;
-    std::queue<std::vector<Dandelion>::iterator> puff_queue;
-    for (int y = 0; y < 50; ++y) {
-      for (int x = 0; x < 50; ++x) {
-        auto &vec = grid4[y][x];
-        for (auto i = vec.begin(); i < vec.end(); ++i) {
-          int rc = handle_dandelion(*i, mtrandom4);
-          if (rc == 2) {
-            death_queue.push_back(i);
-          } else if (rc == 1) {
-            puff_queue.push(i);
-          }
-        }
-        while (puff_queue.size() > 0) {
-          auto i = puff_queue.front();
-          puff_queue.pop();
-          int seeds = seeds_dist(mtrandom4);
-          if (i->is_first) {
-            seeds /= ratio;
-          }
-          for (int j = 0; j < seeds; ++j) {
-            GridCoords seed = gen_seed(mtrandom4);
-            GridCoords new_coords = {x + 50 + seed.x, y + 50 - seed.y};
-            if (new_coords.x < 0 || new_coords.y < 0 || new_coords.x > 99 ||
-                new_coords.y > 99) {
-              continue;
-            }
-            grid4_seed_queue.push({new_coords, Dandelion(mtrandom4)});
-            full_grid[new_coords.y][new_coords.x] += ratio;
-            total_dandelion_number += ratio;
-          }
-        }
-        while (death_queue.size() > 0) {
-          auto i = death_queue.back();
-          death_queue.pop_back();
-          vec.erase(i);
-          full_grid[y + 50][x + 50] -= ratio;
-          total_dandelion_number -= ratio;
-        }
-      }
+    w.sent_tiles.clear();
+    if (pipelined) {
+      w.outboxes.swap(w.sent_outboxes);
+      w.seed_counts.swap(w.sent_counts);
     }
-    cv4_state = 0;
-    lk.unlock();
-    cv4.notify_one();
+  }
+  std::sort(delivery_tiles.begin(), delivery_tiles.end());
+  delivery_tiles.erase(
+      std::unique(delivery_tiles.begin(), delivery_tiles.end()),
+      delivery_tiles.end());
+  for (std::size_t t : delivery_tiles) {
+    occupy(tiles[t]);
+    tiles[t].receiving = true;
   }
 }
 
-void handle_seed_queue(std::queue<NewSeed> &seed_queue) {
-  while (seed_queue.size() > 0) {
-    NewSeed seed = seed_queue.front();
-    seed_queue.pop();
-    int x = seed.coords.x;
-    int y = seed.coords.y;
-    if (x < 0 || y < 0 || x > 99 || y > 99) {
-      continue;
+void add_births() {
+  std::int64_t born = 0;
+  for (Worker &w : workers) {
+    born += w.population_born;
+    w.population_born = 0;
+  }
+  total_dandelion_number += born;
+}
+
+void add_population_changes() {
+  add_births();
+  std::int64_t change = 0;
+  for (Worker &w : workers) {
+    change += w.population_change;
+    w.population_change = 0;
+  }
+  total_dandelion_number += change;
+}
+
+void stop_workers() {
+  workers_exit = true;
+  step.fetch_add(1, std::memory_order_release);
+  wake_all(step);
+}
+
+// Saves a frame's density as date.png and date.txt
+void save_snapshot(const Frame &frame) {
+  std::string image_filename = frame.weather->date + ".png";
+  std::cout << "Saving " << image_filename << "..." << std::endl;
+  // 800 pixels wide up to 800 cells, a pixel per cell after that
+  int scale = std::max(1, 800 / segments);
+  int image_size = segments * scale;
+  std::size_t image_bytes =
+      static_cast<std::size_t>(image_size) * image_size * 3;
+  unsigned char *image = static_cast<unsigned char *>(std::malloc(image_bytes));
+  for (std::size_t i = 0; i < image_bytes; ++i) {
+    image[i] = 255;
+  }
+  run_jobs(image_size, [&frame, image, image_size, scale](std::size_t y) {
+    for (int x = 0; x < image_size; ++x) {
+      int gridy = y / scale;
+      int gridx = x / scale;
+      std::int64_t size = frame.count(gridx, gridy);
+      if (size > 0) {
+        int diff = std::min<std::int64_t>((size / 100 + 1) * 10, 240);
+        unsigned char val = static_cast<unsigned char>(255 - diff);
+        std::size_t pixel = (static_cast<std::size_t>(y) * image_size + x) * 3;
+        image[pixel] = val;
+        image[pixel + 1] = val;
+        image[pixel + 2] = val;
+      }
     }
-    if (x <= 49 && y <= 49) {
-      grid1[y][x].push_back(seed.dandelion);
-    } else if (x > 49 && y <= 49) {
-      grid2[y][x - 50].push_back(seed.dandelion);
-    } else if (x <= 49 && y > 49) {
-      grid3[y - 50][x].push_back(seed.dandelion);
-    } else {
-      grid4[y - 50][x - 50].push_back(seed.dandelion);
+  });
+  stbi_write_png(image_filename.c_str(), image_size, image_size, 3, image,
+                 image_size * 3);
+  free(image);
+  std::string text_filename = frame.weather->date + ".txt";
+  std::cout << "Saving " << text_filename << "..." << std::endl;
+  std::ofstream text_file(text_filename);
+  for (int y = 0; y < segments; ++y) {
+    for (int x = 0; x < segments; ++x) {
+      text_file << frame.count(x, y) << ' ';
     }
+    text_file << '\n';
+  }
+}
+
+// Saves the snapshots due on the master's frame and publishes it
+void finish_frame() {
+  Frame &frame = frames[back_frame];
+  if (std::binary_search(snap_days.begin(), snap_days.end(),
+                         frame.weather->day)) {
+    save_snapshot(frame);
+  }
+  publish_frame();
+}
+
+// Delivers the seeds a pipelined day left for the next one on their own, when
+// no next day is coming to overlap them with, and finishes that day's frame
+void deliver_pending() {
+  run_workers(Phase::Deliver, delivery_tiles);
+  add_population_changes();
+  births_pending = false;
+  Frame &frame = frames[back_frame];
+  frame.total = total_dandelion_number;
+  for (std::size_t t : active_tiles) {
+    frame.density[t] = tiles[t].density;
   }
+  finish_frame();
 }
 
 void simulate_master() {
-  std::thread worker1_thread(worker1);
-  std::thread worker2_thread(worker2);
-  std::thread worker3_thread(worker3);
-  std::thread worker4_thread(worker4);
+  counts_allocations = true;
+  std::vector<std::thread> worker_threads;
+  for (std::size_t i = 0; i < workers.size(); ++i) {
+    worker_threads.emplace_back(worker, i);
+  }
 
   auto last_frame = std::chrono::high_resolution_clock::now();
 
   while (!should_close) {
+    if (births_pending && paused) {
+      deliver_pending();
+    }
     if (!paused) {
-      for (const auto &s : snap_dates) {
-        if (date == s) {
-          std::string image_filename = date + ".png";
-          std::cout << "Saving " << image_filename << "..." << std::endl;
-          unsigned char *image =
-              static_cast<unsigned char *>(std::malloc(800 * 800 * 3));
-          for (int i = 0; i < 800 * 800 * 3; ++i) {
-            image[i] = 255;
-          }
-          for (int y = 0; y < 800; ++y) {
-            for (int x = 0; x < 800; ++x) {
-              int gridy = y / 8;
-              int gridx = x / 8;
-              int size = full_grid[gridy][gridx];
-              if (size > 0) {
-                int diff = clamp(((size / 100) + 1) * 10, 0, 240);
-                unsigned char val = static_cast<unsigned char>(255 - diff);
-                image[y * 800 * 3 + x * 3] = val;
-                image[y * 800 * 3 + x * 3 + 1] = val;
-                image[y * 800 * 3 + x * 3 + 2] = val;
-              }
-            }
-          }
-          stbi_write_png(image_filename.c_str(), 800, 800, 3, image, 800 * 3);
-          free(image);
-          std::string text_filename = date + ".txt";
-          std::cout << "Saving " << text_filename << "..." << std::endl;
-          std::ofstream text_file(text_filename);
-          for (int y = 0; y < segments; ++y) {
-            for (int x = 0; x < segments; ++x) {
-              text_file << full_grid[y][x] << ' ';
-            }
-            text_file << '\n';
-          }
+      std::uint64_t day_allocations = allocations;
+      if (weather_index == environments.size()) {
+        if (headless) {
+          std::cout << "Real world data ran out! Stopping." << std::endl;
+          should_close = true;
+        } else {
+          std::cout << "Real world data ran out! Pausing." << std::endl;
+          paused = true;
         }
+        continue;
       }
-      if (!reader->read_row(date, ntemperature, nprecipitation, nwind_dir,
-                            nwind_speed)) {
-        std::cout << "Real world data ran out! Pausing." << std::endl;
-        paused = true;
+      // checked before the day's dispersal, whose buffers are still as large
+      // as the previous day left them
+      if (memory_limit > 0 && population_bytes > memory_limit) {
+        if (headless) {
+          std::cout << "Population outgrew the memory limit! Stopping."
+                    << std::endl;
+          should_close = true;
+        } else {
+          std::cout << "Population outgrew the memory limit! Pausing."
+                    << std::endl;
+          paused = true;
+        }
         continue;
       }
-      temperature = ntemperature;
-      precipitation = nprecipitation;
-      wind_dir = nwind_dir;
-      wind_speed = nwind_speed;
-      int month = (date[5] - 48) * 10 + (date[6] - 48);
-      if (month == 12 || month == 1 || month == 2) {
-        season = Season::Winter;
-      } else if (month >= 3 && month <= 5) {
-        season = Season::Spring;
-      } else if (month >= 6 && month <= 8) {
-        season = Season::Summer;
+      environment = &environments[weather_index++];
+      make_dispersal_kernel(dispersal_kernel, *environment);
+
+      if (births_pending) {
+        // delivers the previous day's seeds while advancing today, and
+        // finishes that day's frame
+        run_workers(Phase::Step, active_tiles);
+        births_pending = false;
+        add_births();
+        frames[back_frame].total = total_dandelion_number;
+        finish_frame();
       } else {
-        season = Season::Autumn;
+        run_workers(Phase::Advance, active_tiles);
+      }
+      std::size_t releasing = 0;
+      for (Worker &w : workers) {
+        releasing += w.releasing_cells;
+        w.releasing_cells = 0;
+      }
+      add_population_changes();
+      if (convolving) {
+        convolve_seeds(releasing);
+      }
+      // every releasing cell scatters at least a puffball's seeds. This does
+      // not depend on the threads, to keep runs reproducible. Seeds mode needs
+      // every seed's own dandelion.
+      bool use_fft;
+      double scatter = sample_cost * seeds_dist.a() * releasing;
+      convolving = dispersal == Dispersal::Counts &&
+                   convolve_cost(releasing, use_fft) < scatter;
+      collect_deliveries();
+      if (!delivery_tiles.empty()) {
+        if (pipelined) {
+          births_pending = true;
+        } else {
+          run_workers(Phase::Deliver, delivery_tiles);
+          add_population_changes();
+        }
+      }
+      std::uint64_t day_allocations_made = allocations - day_allocations;
+
+      if (births_pending) {
+        start_frame();
+      } else {
+        fill_frame();
+        finish_frame();
+      }
+
+      // headless runs go as fast as the workers can finish
+      if (!headless) {
+        auto dur = std::chrono::high_resolution_clock::now() - last_frame;
+        std::this_thread::sleep_for(
+            std::chrono::duration<float, std::milli>(day_length) - dur);
       }
-      humidity = humidities[static_cast<int>(season.load())]
-                           [static_cast<int>(climate.load())];
-      light = lights[static_cast<int>(season.load())]
-                    [static_cast<int>(climate.load())];
-
-      cv1_state = 1;
-      cv2_state = 1;
-      cv3_state = 1;
-      cv4_state = 1;
-      cv1.notify_one();
-      cv2.notify_one();
-      cv3.notify_one();
-      cv4.notify_one();
-
-      std::unique_lock lk1(grid1_mutex);
-      cv1.wait(lk1, [] { return cv1_state == 0; });
-      std::unique_lock lk2(grid2_mutex);
-      cv2.wait(lk2, [] { return cv2_state == 0; });
-      std::unique_lock lk3(grid3_mutex);
-      cv3.wait(lk3, [] { return cv3_state == 0; });
-      std::unique_lock lk4(grid4_mutex);
-      cv4.wait(lk4, [] { return cv4_state == 0; });
-
-      handle_seed_queue(grid1_seed_queue);
-      handle_seed_queue(grid2_seed_queue);
-      handle_seed_queue(grid3_seed_queue);
-      handle_seed_queue(grid4_seed_queue);
-
-      lk1.unlock();
-      lk2.unlock();
-      lk3.unlock();
-      lk4.unlock();
-
-      auto dur = std::chrono::high_resolution_clock::now() - last_frame;
-      std::this_thread::sleep_for(
-          std::chrono::duration<float, std::milli>(day_length) - dur);
 
       auto current_frame = std::chrono::high_resolution_clock::now();
       last_frame = current_frame;
 
+      if (print_allocations) {
+        std::cout << "Day " << day << ": " << day_allocations_made
+                  << " allocations, " << megabytes(population_bytes)
+                  << " of population" << std::endl;
+      }
       day++;
     }
   }
-  cv1_state = 1;
-  cv2_state = 1;
-  cv3_state = 1;
-  cv4_state = 1;
-  cv1.notify_one();
-  cv2.notify_one();
-  cv3.notify_one();
-  cv4.notify_one();
+  if (births_pending) {
+    deliver_pending();
+  }
+  stop_workers();
 
-  worker1_thread.join();
-  worker2_thread.join();
-  worker3_thread.join();
-  worker4_thread.join();
+  for (std::thread &t : worker_threads) {
+    t.join();
+  }
 }
 
 Vector2 transform_point(Vector2 in) {
@@ -669,53 +2826,147 @@ Vector2 transform_point(Vector2 in) {
                              static_cast<float>(top_bar_height))};
 }
 
+// Field coordinates of a point in the window
+Vector2 untransform_point(Vector2 in) {
+  return {static_cast<float>((in.x - view_width / 2.0f) / zoom + camera.x),
+          static_cast<float>(-(in.y - view_height / 2.0f - top_bar_height) /
+                                 zoom +
+                             camera.y)};
+}
+
 Vector2 transform_size(Vector2 in) {
   return {static_cast<float>(zoom * in.x), static_cast<float>(zoom * in.y)};
 }
 
 int main(int argc, char **argv) {
-  if (argc < 4) {
+  std::vector<char *> args;
+  std::string kernel_name;
+  int threads = std::thread::hardware_concurrency();
+  int tiles_per_side = 20;
+  bool seeded = false;
+  const char *convert_path = nullptr;
+  bool bad_option = false;
+  for (int i = 1; i < argc; ++i) {
+    if (std::strcmp(argv[i], "--headless") == 0) {
+      headless = true;
+    } else if (std::strncmp(argv[i], "--kernel=", 9) == 0) {
+      kernel_name = argv[i] + 9;
+    } else if (std::strcmp(argv[i], "--dispersal=counts") == 0) {
+      dispersal = Dispersal::Counts;
+    } else if (std::strcmp(argv[i], "--dispersal=seeds") == 0) {
+      dispersal = Dispersal::Seeds;
+    } else if (std::strcmp(argv[i], "--cohorts") == 0) {
+      cohort_mode = true;
+    } else if (std::strncmp(argv[i], "--convert=", 10) == 0) {
+      convert_path = argv[i] + 10;
+    } else if (std::strcmp(argv[i], "--pipelined") == 0) {
+      pipelined = true;
+    } else if (std::strcmp(argv[i], "--allocs") == 0) {
+      print_allocations = true;
+    } else if (std::strncmp(argv[i], "--memory-limit=", 15) == 0) {
+      memory_limit = std::stoull(argv[i] + 15) << 20;
+    } else if (std::strncmp(argv[i], "--threads=", 10) == 0) {
+      threads = std::stoi(argv[i] + 10);
+    } else if (std::strncmp(argv[i], "--seed=", 7) == 0) {
+      run_seed = std::stoull(argv[i] + 7);
+      seeded = true;
+    } else if (std::strncmp(argv[i], "--size=", 7) == 0) {
+      segments = std::max(std::stoi(argv[i] + 7), 1);
+    } else if (std::strncmp(argv[i], "--tiles=", 8) == 0) {
+      tiles_per_side = std::stoi(argv[i] + 8);
+    } else if (std::strncmp(argv[i], "--", 2) == 0) {
+      std::cout << "Unknown option " << argv[i] << std::endl;
+      bad_option = true;
+    } else {
+      args.push_back(argv[i]);
+    }
+  }
+  if (!kernel_name.empty() && kernel_name != "scalar" &&
+      kernel_name != "sse4.1" && kernel_name != "avx2") {
+    std::cout << "Unknown kernel " << kernel_name << std::endl;
+    bad_option = true;
+  }
+  if (convert_path && !args.empty() && !bad_option) {
+    return convert_weather(args[0], convert_path) ? 0 : 1;
+  }
+  if (args.size() < 3 || bad_option) {
     std::cout << "usage: " << argv[0]
-              << " <filename> [polar|continental|tropical|desert|temperate] "
-                 "<ratio> snap_dates"
+              << " [--headless] [--kernel=scalar|sse4.1|avx2] "
+                 "[--dispersal=seeds|counts] [--cohorts] [--pipelined] "
+                 "[--threads=N] [--seed=N] [--size=N] [--tiles=N] [--allocs] "
+                 "[--memory-limit=MB] <filename> "
+                 "[polar|continental|tropical|desert|temperate] "
+                 "<ratio> snap_dates\n"
+              << "       " << argv[0] << " --convert=<weather.bin> <filename>"
               << std::endl;
-    return 0;
+    return bad_option ? 1 : 0;
   }
 
+  lifecycle_kernel = select_lifecycle_kernel(kernel_name);
+
   std::random_device real_random;
 
-  mtrandom = std::mt19937(real_random());
-  mtrandom1 = std::mt19937(real_random());
-  mtrandom2 = std::mt19937(real_random());
-  mtrandom3 = std::mt19937(real_random());
-  mtrandom4 = std::mt19937(real_random());
-
-  io::CSVReader<5> data_reader(argv[1]);
-  data_reader.read_header(io::ignore_extra_column | io::ignore_missing_column,
-                          "date", "tavg", "prcp", "wdir", "wspd");
-  reader = &data_reader;
-  if (std::strcmp(argv[2], "polar") == 0) {
+  if (!seeded) {
+    run_seed =
+        (static_cast<std::uint64_t>(real_random()) << 32) | real_random();
+  }
+
+  tiles_per_side = clamp(tiles_per_side, 1, segments);
+  tile_size = (segments + tiles_per_side - 1) / tiles_per_side;
+  tiles_x = (segments + tile_size - 1) / tile_size;
+  for (int y = 0; y < segments; y += tile_size) {
+    for (int x = 0; x < segments; x += tile_size) {
+      tiles.emplace_back(x, y, std::min(tile_size, segments - x),
+                         std::min(tile_size, segments - y));
+    }
+  }
+  workers = std::vector<Worker>(std::max(threads, 1));
+  spin_waits = std::thread::hardware_concurrency() > 1;
+  for (Worker &w : workers) {
+    w.outboxes.resize(tiles.size());
+    w.seed_counts.resize(tiles.size());
+    w.sent.resize(tiles.size());
+    if (pipelined) {
+      w.sent_outboxes.resize(tiles.size());
+      w.sent_counts.resize(tiles.size());
+    }
+  }
+
+  if (std::strcmp(args[1], "polar") == 0) {
     climate = Climate::Polar;
-  } else if (std::strcmp(argv[2], "continental") == 0) {
+  } else if (std::strcmp(args[1], "continental") == 0) {
     climate = Climate::Continental;
-  } else if (std::strcmp(argv[2], "tropical") == 0) {
+  } else if (std::strcmp(args[1], "tropical") == 0) {
     climate = Climate::Tropical;
-  } else if (std::strcmp(argv[2], "desert") == 0) {
+  } else if (std::strcmp(args[1], "desert") == 0) {
     climate = Climate::Desert;
   } else {
     climate = Climate::Temperate;
   }
-  int rat = std::stoi(argv[3]);
+  if (!load_weather(args[0])) {
+    return 1;
+  }
+  int rat = std::stoi(args[2]);
   if (rat > 0) {
     ratio = rat;
   }
-  snap_dates.reserve(argc - 4);
-  for (int i = 4; i < argc; ++i) {
-    snap_dates.push_back(argv[i]);
+  for (std::size_t i = 3; i < args.size(); ++i) {
+    std::int32_t snap_day = parse_date(args[i]);
+    if (snap_day == INT32_MIN) {
+      std::cout << "Ignoring snapshot date " << args[i] << std::endl;
+      continue;
+    }
+    snap_days.push_back(snap_day);
   }
+  std::sort(snap_days.begin(), snap_days.end());
 
   // FIRST DANDELION
-  Dandelion first_dandelion = Dandelion(mtrandom);
+  // in the middle of the field, (49, 49) on the default 100x100 one and (0, 0)
+  // on a 1x1 one
+  int centre = std::max(segments / 2 - 1, 0);
+  // drawn on day 0, before the first day
+  Philox first_rng(run_seed, 0, centre * segments + centre, births_stream);
+  Dandelion first_dandelion = Dandelion(first_rng);
   first_dandelion.age =
       first_dandelion.germination_time + first_dandelion.mature_time +
       first_dandelion.flower_time + first_dandelion.wither_time +
@@ -723,9 +2974,44 @@ int main(int argc, char **argv) {
   first_dandelion.days_since_last_stage = first_dandelion.puffball_time;
   first_dandelion.stage = Dandelion::Stage::Puffball;
   first_dandelion.is_first = true;
-  grid1[49][49].push_back(first_dandelion);
-  full_grid[49][49]++;
+  if (cohort_mode) {
+    // cohorts are born from seed counts
+    dispersal = Dispersal::Counts;
+    init_duration_classes();
+    Cohort first_cohort;
+    first_cohort.count = 1;
+    first_cohort.age = first_dandelion.age;
+    first_cohort.days_since_last_stage = first_dandelion.days_since_last_stage;
+    first_cohort.stage = first_dandelion.stage;
+    first_cohort.is_first = true;
+    first_cohort.members[stage_classes[4].classify(
+        first_dandelion.puffball_time)] = 1;
+    Tile &tile = tile_at(centre, centre);
+    int cell = (centre - tile.y) * tile.width + (centre - tile.x);
+    occupy(tile);
+    tile.cohorts.cohorts.push_back(first_cohort);
+    std::fill(tile.cohorts.cell_start.begin() + cell + 1,
+              tile.cohorts.cell_start.end(), 1);
+  } else {
+    Tile &tile = tile_at(centre, centre);
+    occupy(tile);
+    tile.births.push_back(
+        {{centre - tile.x, centre - tile.y}, first_dandelion});
+    insert_births(tile);
+  }
+  grid_cell(centre, centre)++;
   total_dandelion_number++;
+  fill_frame();
+  publish_frame();
+
+  if (headless) {
+    simulate_master();
+    std::cout << "Population storage: " << megabytes(population_bytes)
+              << ", peak " << megabytes(population_peak) << std::endl;
+    std::cout << "Day " << day << ": " << total_dandelion_number
+              << " dandelions" << std::endl;
+    return 0;
+  }
 
   SetConfigFlags(FLAG_MSAA_4X_HINT);
   InitWindow(win_width, win_height, "dandelion");
@@ -738,6 +3024,7 @@ int main(int argc, char **argv) {
   GridCoords selected = {-1, -1};
 
   while (!WindowShouldClose()) {
+    const Frame &frame = latest_frame();
     mouse_position = GetMousePosition();
 
     if (IsKeyDown(KEY_RIGHT))
@@ -761,31 +3048,17 @@ int main(int argc, char **argv) {
 
     if (IsMouseButtonReleased(MOUSE_LEFT_BUTTON)) {
       if (!dragging) {
-        bool found = false;
+        selected = {-1, -1};
         if (CheckCollisionPointRec(
                 mouse_position, {0, top_bar_height, view_width, view_height})) {
-          for (int y = 0; y < segments; ++y) {
-            for (int x = 0; x < segments; ++x) {
-              float block_size = 8.0f;
-              Vector2 top_left = {static_cast<float>((x * block_size) - 400),
-                                  static_cast<float>(400 - (y * block_size))};
-              top_left = transform_point(top_left);
-              if (CheckCollisionPointRec(
-                      mouse_position,
-                      {top_left.x, top_left.y, block_size, block_size})) {
-                selected = {x, y};
-                found = true;
-                break;
-              }
-            }
-            if (found) {
-              break;
-            }
+          float block_size = static_cast<float>(view_width) / segments;
+          Vector2 point = untransform_point(mouse_position);
+          int x = std::floor((point.x + 400.0f) / block_size);
+          int y = std::floor((400.0f - point.y) / block_size);
+          if (x >= 0 && y >= 0 && x < segments && y < segments) {
+            selected = {x, y};
           }
         }
-        if (!found) {
-          selected = {-1, -1};
-        }
       }
       dragging = false;
     }
@@ -815,27 +3088,35 @@ int main(int argc, char **argv) {
     Vector2 size = {view_width, view_height};
     DrawRectangleV(transform_point(top_left), transform_size(size), WHITE);
 
-    for (int y = 0; y < segments; ++y) {
-      for (int x = 0; x < segments; ++x) {
-        bool s = false;
-        if (selected.x == x && selected.y == y) {
-          s = true;
-        }
-        int size = full_grid[y][x];
-        Vector2 top_left = transform_point(
-            {static_cast<float>(x * 8 - 400), static_cast<float>(400 - y * 8)});
-        if (size > 0) {
-          int diff = clamp(((size / 100) + 1) * 10, 0, 240);
+    // only occupied tiles have anything to draw
+    float block_size = static_cast<float>(view_width) / segments;
+    Vector2 block = transform_size({block_size, block_size});
+    for (std::size_t t = 0; t < frame.density.size(); ++t) {
+      if (frame.density[t].empty()) {
+        continue;
+      }
+      const Tile &tile = tiles[t];
+      for (int y = tile.y; y < tile.y + tile.height; ++y) {
+        for (int x = tile.x; x < tile.x + tile.width; ++x) {
+          std::int64_t size =
+              frame.density[t][(y - tile.y) * tile.width + (x - tile.x)];
+          if (size <= 0) {
+            continue;
+          }
+          int diff = std::min<std::int64_t>((size / 100 + 1) * 10, 240);
           unsigned char val = static_cast<unsigned char>(255 - diff);
           Color c = {val, val, val, 255};
-          DrawRectangleV(top_left, transform_size({8.0f, 8.0f}), c);
-        }
-        if (s) {
-          DrawRectangleLines(top_left.x, top_left.y, zoom * 8.0f, zoom * 8.0f,
-                             GREEN);
+          DrawRectangleV(transform_point({x * block_size - 400.0f,
+                                          400.0f - y * block_size}),
+                         block, c);
         }
       }
     }
+    if (selected.x != -1 && selected.y != -1) {
+      Vector2 top_left = transform_point({selected.x * block_size - 400.0f,
+                                          400.0f - selected.y * block_size});
+      DrawRectangleLines(top_left.x, top_left.y, block.x, block.y, GREEN);
+    }
 
     // TOP BAR
     DrawRectangle(0, 0, view_width, top_bar_height, RAYWHITE);
@@ -843,14 +3124,15 @@ int main(int argc, char **argv) {
 
     std::string status_text =
         fmt::format("{} | {:.1f} C | {}% | {:.2f} h | {:.1f} | {} | {:.2f}",
-                    season_strings[static_cast<int>(season.load())],
-                    temperature.load(), humidity.load(), light.load(),
-                    precipitation.load(), wind_dir.load(), wind_speed.load());
+                    season_strings[static_cast<int>(frame.weather->season)],
+                    frame.weather->temperature, frame.weather->humidity,
+                    frame.weather->light, frame.weather->precipitation,
+                    frame.weather->wind_dir, frame.weather->wind_speed);
     DrawText(status_text.c_str(), 10, 10, 20, BLACK);
 
     if (selected.x != -1 && selected.y != -1) {
       std::string num_text =
-          fmt::format("{}", full_grid[selected.y][selected.x].load());
+          fmt::format("{}", frame.count(selected.x, selected.y));
       int num_text_width = MeasureText(num_text.c_str(), 20);
       DrawText(num_text.c_str(), view_width - 10 - num_text_width, 10, 20,
                BLACK);
@@ -873,7 +3155,7 @@ int main(int argc, char **argv) {
         paused = true;
       }
     }
-    DrawText(fmt::format("Day {}", day.load()).c_str(), 40,
+    DrawText(fmt::format("Day {}", frame.day).c_str(), 40,
              top_bar_height + view_height + 10, 20, BLACK);
 
     Rectangle zoom_in_rec = {view_width - 30, top_bar_height + view_height + 10,
@@ -891,7 +3173,7 @@ int main(int argc, char **argv) {
     DrawText(zoom_text.c_str(), win_width - 70 - zoom_text_width,
              top_bar_height + view_height + 10, 20, BLACK);
 
-    std::string total_text = fmt::format("{}", total_dandelion_number.load());
+    std::string total_text = fmt::format("{}", frame.total);
     int total_text_width = MeasureText(total_text.c_str(), 20);
     DrawText(total_text.c_str(), (view_width - total_text_width) / 2,
              top_bar_height + view_height + 10, 20, BLACK);